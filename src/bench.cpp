@@ -0,0 +1,795 @@
+
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <cmath>
+#include <cstdlib>
+
+#include <rf/util/Vec2.hpp>
+#include <rf/util/Map.hpp>
+#include <rf/util/Dijkstra.hpp>
+#include <rf/util/Chamfer.hpp>
+#include <rf/util/ThreadPool.hpp>
+#include <rf/util/AStar.hpp>
+#include <rf/util/ClusterGraph.hpp>
+#include <rf/util/PathCache.hpp>
+#include <rf/util/FOV.hpp>
+#include <rf/util/FOVBatch.hpp>
+#include <rf/game/worldgen.hpp>
+#include <rf/game/TurnScheduler.hpp>
+#include <rf/game/Game.hpp>
+
+using namespace rf;
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed_ms(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// uniform walk costs, with roughly one in five cells impassable
+static Map<unsigned int> forest_costs(Vec2u size, unsigned int seed) {
+  std::mt19937 gen(seed);
+  Map<unsigned int> costs(size);
+  for(unsigned int y = 0 ; y < size.y ; y ++) {
+    for(unsigned int x = 0 ; x < size.x ; x ++) {
+      costs[Vec2u(x, y)] = (gen() % 5 == 0) ? DijkstraMap::impassable : 1;
+    }
+  }
+  return costs;
+}
+
+static void bench_dijkstra() {
+  printf("DijkstraMap::compute\n");
+  printf("%10s %8s %14s %12s\n", "size", "queue", "bytes/cell", "ms/compute");
+
+  const unsigned int sizes[] = { 64, 256, 1024 };
+
+  for(unsigned int size : sizes) {
+    auto costs = forest_costs(Vec2u(size, size), size);
+    Vec2u start(size/2, size/2);
+    costs[start] = 1;
+
+    unsigned int reps = 4*1024*1024 / (size*size) + 1;
+
+    for(auto mode : { DijkstraMap::HEAP, DijkstraMap::BUCKET }) {
+      DijkstraMap dm;
+      dm.set_queue_mode(mode);
+
+      Map<DijkstraMap::Distance> distances;
+      dm.compute(distances, costs, start);
+
+      auto t0 = Clock::now();
+      for(unsigned int i = 0 ; i < reps ; i ++) {
+        dm.compute(distances, costs, start);
+      }
+      double ms = elapsed_ms(t0) / reps;
+
+      printf("%4ux%-5u %8s %14.2f %12.3f\n",
+             size, size,
+             mode == DijkstraMap::HEAP ? "heap" : "bucket",
+             (double)dm.memory_usage() / (size*size),
+             ms);
+    }
+  }
+}
+
+static void bench_dijkstra_batch() {
+  printf("DijkstraMap::compute_batch, 256x256\n");
+  printf("%8s %8s %12s %12s\n", "fields", "threads", "ms/batch", "ms/field");
+
+  const Vec2u size(256, 256);
+  auto costs = forest_costs(size, 1);
+
+  std::mt19937 gen(1);
+  ThreadPool pool;
+
+  for(unsigned int field_num : { 1, 4, 16, 64 }) {
+    std::vector<std::vector<DijkstraMap::Goal>> starts(field_num);
+    for(auto & start : starts) {
+      Vec2u p(gen() % size.x, gen() % size.y);
+      costs[p] = 1;
+      start.push_back(std::make_pair(p, 0));
+    }
+
+    for(ThreadPool * p : { (ThreadPool *)nullptr, &pool }) {
+      DijkstraMap dm;
+      dm.set_queue_mode(DijkstraMap::BUCKET);
+
+      std::vector<Map<DijkstraMap::Distance>> distances;
+      dm.compute_batch(distances, costs, starts, p);
+
+      const unsigned int reps = 8;
+      auto t0 = Clock::now();
+      for(unsigned int i = 0 ; i < reps ; i ++) {
+        dm.compute_batch(distances, costs, starts, p);
+      }
+      double ms = elapsed_ms(t0) / reps;
+
+      printf("%8u %8u %12.3f %12.3f\n",
+             field_num, p ? p->size() : 1, ms, ms / field_num);
+    }
+  }
+}
+
+static void bench_chamfer() {
+  printf("ChamferMap::compute vs. DijkstraMap::compute (bucket)\n");
+  printf("%10s %8s %14s %14s\n", "size", "sweeps", "ms/chamfer", "ms/dijkstra");
+
+  const unsigned int sizes[] = { 64, 256, 1024 };
+
+  for(unsigned int size : sizes) {
+    auto costs = forest_costs(Vec2u(size, size), size);
+    Vec2u start(size/2, size/2);
+    costs[start] = 1;
+
+    unsigned int reps = 4*1024*1024 / (size*size) + 1;
+
+    ChamferMap cm;
+    Map<DijkstraMap::Distance> distances;
+    cm.compute(distances, costs, start);
+
+    auto t0 = Clock::now();
+    for(unsigned int i = 0 ; i < reps ; i ++) {
+      cm.compute(distances, costs, start);
+    }
+    double chamfer_ms = elapsed_ms(t0) / reps;
+
+    DijkstraMap dm;
+    dm.set_queue_mode(DijkstraMap::BUCKET);
+    dm.compute(distances, costs, start);
+
+    t0 = Clock::now();
+    for(unsigned int i = 0 ; i < reps ; i ++) {
+      dm.compute(distances, costs, start);
+    }
+    double dijkstra_ms = elapsed_ms(t0) / reps;
+
+    printf("%4ux%-5u %8u %14.3f %14.3f\n",
+           size, size, cm.sweep_count(), chamfer_ms, dijkstra_ms);
+  }
+}
+
+// walk costs as Game derives them, with every object blocking its cell
+static Map<unsigned int> level_costs(const game::Level & level) {
+  Map<unsigned int> costs(level.tiles.size());
+  costs.fill(1);
+  for(auto & entry : level.objects) {
+    costs.at(entry.object.pos()) = DijkstraMap::impassable;
+  }
+  return costs;
+}
+
+static void bench_astar() {
+  printf("AStarSearch::find8 vs. AStarSearch::find_jps8, troll_forest\n");
+  printf("%10s %8s %12s %12s %12s %12s\n",
+         "size", "paths", "a* nodes", "a* ms", "jps nodes", "jps ms");
+
+  const unsigned int sizes[] = { 64, 128, 256, 512 };
+
+  for(unsigned int size : sizes) {
+    auto costs = level_costs(game::worldgen::troll_forest(size, Vec2u(size, size)));
+
+    // endpoints are picked among open cells, far enough apart to be interesting
+    std::mt19937 gen(size);
+    std::vector<std::pair<Vec2i, Vec2i>> queries;
+    while(queries.size() < 32) {
+      Vec2i a(gen() % size, gen() % size);
+      Vec2i b(gen() % size, gen() % size);
+      if(costs[a] == 1 && costs[b] == 1 &&
+         std::abs(a.x - b.x) + std::abs(a.y - b.y) > (int)size/2) {
+        queries.push_back(std::make_pair(a, b));
+      }
+    }
+
+    AStarSearch astar;
+    AStarSearch jps;
+    std::vector<Vec2i> astar_path;
+    std::vector<Vec2i> jps_path;
+
+    unsigned long astar_nodes = 0;
+    unsigned long jps_nodes = 0;
+    double astar_ms = 0.0;
+    double jps_ms = 0.0;
+
+    for(auto & query : queries) {
+      auto t0 = Clock::now();
+      astar.find8(astar_path, costs, query.first, query.second);
+      astar_ms += elapsed_ms(t0);
+      astar_nodes += astar.expanded_count();
+
+      t0 = Clock::now();
+      jps.find_jps8(jps_path, costs, query.first, query.second);
+      jps_ms += elapsed_ms(t0);
+      jps_nodes += jps.expanded_count();
+
+      if(astar_path.size() != jps_path.size()) {
+        printf("path length mismatch: %zu vs. %zu\n", astar_path.size(), jps_path.size());
+      }
+    }
+
+    printf("%4ux%-5u %8zu %12lu %12.3f %12lu %12.3f\n",
+           size, size, queries.size(),
+           astar_nodes / queries.size(), astar_ms / queries.size(),
+           jps_nodes / queries.size(), jps_ms / queries.size());
+  }
+}
+
+static void bench_cluster_graph() {
+  printf("ClusterGraph (16x16 clusters) vs. AStarSearch::find8, troll_forest\n");
+  printf("%10s %8s %10s %10s %10s %10s %10s %10s %10s %8s\n",
+         "size", "nodes", "build ms", "update ms",
+         "a* nodes", "a* ms", "hpa nodes", "hpa ms", "abstr. ms", "cost");
+
+  const unsigned int sizes[] = { 128, 512, 1024 };
+
+  for(unsigned int size : sizes) {
+    auto costs = level_costs(game::worldgen::troll_forest(size, Vec2u(size, size)));
+
+    std::mt19937 gen(size);
+    std::vector<std::pair<Vec2i, Vec2i>> queries;
+    while(queries.size() < 16) {
+      Vec2i a(gen() % size, gen() % size);
+      Vec2i b(gen() % size, gen() % size);
+      if(costs[a] == 1 && costs[b] == 1 &&
+         std::abs(a.x - b.x) + std::abs(a.y - b.y) > (int)size/2) {
+        queries.push_back(std::make_pair(a, b));
+      }
+    }
+
+    ClusterGraph graph;
+    auto t0 = Clock::now();
+    graph.build(costs);
+    double build_ms = elapsed_ms(t0);
+
+    // toggle single cells, as objects moving about would
+    const unsigned int update_num = 64;
+    t0 = Clock::now();
+    for(unsigned int i = 0 ; i < update_num ; i ++) {
+      Vec2u p(gen() % size, gen() % size);
+      costs[p] = (costs[p] == 1) ? DijkstraMap::impassable : 1;
+      graph.update(costs, std::vector<Vec2u>(1, p));
+      costs[p] = (costs[p] == 1) ? DijkstraMap::impassable : 1;
+      graph.update(costs, std::vector<Vec2u>(1, p));
+    }
+    double update_ms = elapsed_ms(t0) / (2*update_num);
+
+    AStarSearch astar;
+    std::vector<Vec2i> astar_path;
+    std::vector<Vec2i> hpa_path;
+    std::vector<Vec2u> abstract_path;
+
+    unsigned long astar_nodes = 0;
+    unsigned long hpa_nodes = 0;
+    double astar_ms = 0.0;
+    double hpa_ms = 0.0;
+    double abstract_ms = 0.0;
+    unsigned long astar_cost = 0;
+    unsigned long hpa_cost = 0;
+
+    for(auto & query : queries) {
+      t0 = Clock::now();
+      astar.find8(astar_path, costs, query.first, query.second);
+      astar_ms += elapsed_ms(t0);
+      astar_nodes += astar.expanded_count();
+      astar_cost += astar_path.size();
+
+      t0 = Clock::now();
+      graph.find_path(hpa_path, query.first, query.second);
+      hpa_ms += elapsed_ms(t0);
+      hpa_nodes += graph.expanded_count();
+      hpa_cost += hpa_path.size();
+
+      t0 = Clock::now();
+      graph.find_abstract_path(abstract_path, query.first, query.second);
+      abstract_ms += elapsed_ms(t0);
+    }
+
+    printf("%4ux%-5u %8u %10.3f %10.3f %10lu %10.3f %10lu %10.3f %10.3f %8.3f\n",
+           size, size, graph.node_count(), build_ms, update_ms,
+           astar_nodes / queries.size(), astar_ms / queries.size(),
+           hpa_nodes / queries.size(), hpa_ms / queries.size(),
+           abstract_ms / queries.size(),
+           (double)hpa_cost / astar_cost);
+  }
+}
+
+static void bench_path_cache() {
+  printf("PathCache, walkers chasing one target across a 256x256 troll_forest\n");
+  printf("%8s %10s %10s %10s %12s %12s\n",
+         "walkers", "hits", "misses", "cut", "ms/turn", "a* ms/turn");
+
+  const unsigned int size = 256;
+  auto costs = level_costs(game::worldgen::troll_forest(size, Vec2u(size, size)));
+
+  for(unsigned int walker_num : { 4, 16, 64 }) {
+    std::mt19937 gen(walker_num);
+
+    auto open_cell = [&]() {
+      while(true) {
+        Vec2i p(gen() % size, gen() % size);
+        if(costs[p] == 1) { return p; }
+      }
+    };
+
+    Vec2i target = open_cell();
+    std::vector<Vec2i> walkers;
+    for(unsigned int i = 0 ; i < walker_num ; i ++) {
+      walkers.push_back(open_cell());
+    }
+
+    // walkers block their own cells, as in Game; the target wanders off
+    // every so often, which costs everyone a fresh search
+    Map<unsigned int> walk_costs = costs;
+    for(auto & walker : walkers) {
+      walk_costs[walker] = DijkstraMap::impassable;
+    }
+
+    PathCache cache(1024);
+    AStarSearch astar;
+    std::vector<Vec2i> path;
+
+    const unsigned int turns = 64;
+    double cache_ms = 0.0;
+    double astar_ms = 0.0;
+
+    for(unsigned int turn = 0 ; turn < turns ; turn ++) {
+      if(turn % 16 == 15) {
+        target = open_cell();
+      }
+
+      for(auto & walker : walkers) {
+        auto t0 = Clock::now();
+        astar.find8(path, walk_costs, walker, target);
+        astar_ms += elapsed_ms(t0);
+
+        t0 = Clock::now();
+        bool found = cache.find(path, walk_costs, walker, target, PathCache::EIGHT);
+        cache_ms += elapsed_ms(t0);
+
+        if(found && path.size() > 2) {
+          Vec2i next = path[path.size() - 2];
+          walk_costs[walker] = costs[walker];
+          walk_costs[next] = DijkstraMap::impassable;
+          cache.invalidate({ Vec2u(walker), Vec2u(next) });
+          walker = next;
+        }
+      }
+    }
+
+    printf("%8u %10lu %10lu %10lu %12.3f %12.3f\n",
+           walker_num, cache.hit_count(),
+           cache.miss_count(), cache.invalidated_count(),
+           cache_ms / turns, astar_ms / turns);
+  }
+}
+
+// opacity as Game derives it, with every object that never takes a turn solid
+static Map<unsigned int> level_opacity(const game::Level & level) {
+  Map<unsigned int> opacity(level.tiles.size());
+  opacity.fill(0);
+  for(auto & entry : level.objects) {
+    if(!entry.object.has_turn()) {
+      opacity.at(entry.object.pos()) = 1;
+    }
+  }
+  return opacity;
+}
+
+template <typename F>
+static double bench_fov_update(F & fov, const Map<unsigned int> & opacity,
+                               const std::vector<Vec2i> & origins, unsigned int r) {
+  auto t0 = Clock::now();
+  for(auto & origin : origins) {
+    fov.update(opacity, origin, r);
+  }
+  return elapsed_ms(t0) * 1000.0 / origins.size();
+}
+
+static void bench_fov() {
+  const unsigned int size = 256;
+  auto opacity = level_opacity(game::worldgen::troll_forest(size, Vec2u(size, size)));
+
+  std::mt19937 gen(1);
+  auto open_cell = [&](unsigned int border) {
+    while(true) {
+      Vec2i p(border + gen() % (size - 2*border), border + gen() % (size - 2*border));
+      if(opacity[p] == 0) { return p; }
+    }
+  };
+
+  printf("BresenhamFOV vs. ShadowcastFOV::update, 256x256 troll_forest\n");
+  printf("%8s %14s %14s\n", "radius", "bresenham us", "shadowcast us");
+
+  for(unsigned int r : { 15, 30, 60 }) {
+    std::vector<Vec2i> origins;
+    for(unsigned int i = 0 ; i < 256 ; i ++) {
+      origins.push_back(open_cell(0));
+    }
+
+    BresenhamFOV bresenham;
+    ShadowcastFOV shadowcast;
+    double bresenham_us = bench_fov_update(bresenham, opacity, origins, r);
+    double shadowcast_us = bench_fov_update(shadowcast, opacity, origins, r);
+
+    printf("%8u %14.2f %14.2f\n", r, bresenham_us, shadowcast_us);
+  }
+
+  // The ray table against stepping along every ray, at the player's radius
+  {
+    const unsigned int r = 15;
+    std::vector<Vec2i> origins;
+    for(unsigned int i = 0 ; i < 4096 ; i ++) {
+      origins.push_back(open_cell(0));
+    }
+
+    BresenhamFOV bresenham;
+    bresenham.update(opacity, origins[0], r);
+    double table_us = bench_fov_update(bresenham, opacity, origins, r);
+
+    auto t0 = Clock::now();
+    for(auto & origin : origins) {
+      bresenham.update_stepwise(opacity, origin, r);
+    }
+    double stepwise_us = elapsed_ms(t0) * 1000.0 / origins.size();
+
+    printf("BresenhamFOV::update, radius %u: stepwise %.2f us, ray table %.2f us (%.1fx)\n",
+           r, stepwise_us, table_us, stepwise_us / table_us);
+  }
+
+  // Reading an 80x50 screen of visibility back out, as Game::draw does
+  {
+    BresenhamFOV bresenham;
+    bresenham.update(opacity, open_cell(40), 15);
+    const FOV & fov = bresenham;
+
+    const unsigned int frames = 2000;
+    Rect2i roi(bresenham.origin() - Vec2i(25, 10), Vec2i(80, 50));
+
+    unsigned long visible_cells = 0;
+    auto t0 = Clock::now();
+    for(unsigned int k = 0 ; k < frames ; k ++) {
+      for(int j = 0 ; j < roi.size.y ; j ++) {
+        for(int i = 0 ; i < roi.size.x ; i ++) {
+          visible_cells += fov.is_visible(roi.pos + Vec2i(i, j));
+        }
+      }
+    }
+    double per_cell_us = elapsed_ms(t0) * 1000.0 / frames;
+
+    BitGrid visible;
+    t0 = Clock::now();
+    for(unsigned int k = 0 ; k < frames ; k ++) {
+      fov.sample_into(visible, roi);
+      for(int j = 0 ; j < roi.size.y ; j ++) {
+        for(int i = 0 ; i < roi.size.x ; i ++) {
+          visible_cells += visible.get(Vec2u(i, j));
+        }
+      }
+    }
+    double sample_into_us = elapsed_ms(t0) * 1000.0 / frames;
+
+    t0 = Clock::now();
+    for(unsigned int k = 0 ; k < frames ; k ++) {
+      bresenham.for_each_visible(roi, [&](Vec2i p) { visible_cells ++; });
+    }
+    double for_each_us = elapsed_ms(t0) * 1000.0 / frames;
+
+    printf("FOV readback, 80x50: is_visible %.2f us, sample_into %.2f us, "
+           "for_each_visible %.2f us (%lu)\n",
+           per_cell_us, sample_into_us, for_each_us, visible_cells);
+  }
+
+  // Permissiveness: how much each sees, and where they disagree. Symmetry:
+  // of the pairs of open cells within range of each other, how often one
+  // sees the other but not the other way around.
+  const unsigned int r = 15;
+  const unsigned int viewer_num = 400;
+  const unsigned int window = 48;
+
+  std::vector<Vec2i> viewers;
+  Map<int> viewer_ids(Vec2u(size, size));
+  viewer_ids.fill(-1);
+  while(viewers.size() < viewer_num) {
+    Vec2i p = open_cell(size/2 - window/2);
+    if(viewer_ids[p] == -1) {
+      viewer_ids[p] = viewers.size();
+      viewers.push_back(p);
+    }
+  }
+
+  std::vector<std::vector<bool>> bresenham_sees(viewer_num, std::vector<bool>(viewer_num));
+  std::vector<std::vector<bool>> shadowcast_sees(viewer_num, std::vector<bool>(viewer_num));
+
+  unsigned long bresenham_cells = 0;
+  unsigned long shadowcast_cells = 0;
+  unsigned long both_cells = 0;
+
+  BresenhamFOV bresenham;
+  ShadowcastFOV shadowcast;
+
+  for(unsigned int i = 0 ; i < viewer_num ; i ++) {
+    bresenham.update(opacity, viewers[i], r);
+    shadowcast.update(opacity, viewers[i], r);
+
+    for(int y = -(int)r ; y <= (int)r ; y ++) {
+      for(int x = -(int)r ; x <= (int)r ; x ++) {
+        Vec2i p = viewers[i] + Vec2i(x, y);
+        bool b = bresenham.is_visible(p);
+        bool s = shadowcast.is_visible(p);
+        bresenham_cells += b;
+        shadowcast_cells += s;
+        both_cells += b && s;
+      }
+    }
+
+    for(unsigned int j = 0 ; j < viewer_num ; j ++) {
+      bresenham_sees[i][j] = bresenham.is_visible(viewers[j]);
+      shadowcast_sees[i][j] = shadowcast.is_visible(viewers[j]);
+    }
+  }
+
+  unsigned long pairs = 0;
+  unsigned long bresenham_asymmetric = 0;
+  unsigned long shadowcast_asymmetric = 0;
+  for(unsigned int i = 0 ; i < viewer_num ; i ++) {
+    for(unsigned int j = i + 1 ; j < viewer_num ; j ++) {
+      Vec2i d = viewers[j] - viewers[i];
+      if(std::abs(d.x) > (int)r/2 || std::abs(d.y) > (int)r/2) { continue; }
+      pairs ++;
+      bresenham_asymmetric += bresenham_sees[i][j] != bresenham_sees[j][i];
+      shadowcast_asymmetric += shadowcast_sees[i][j] != shadowcast_sees[j][i];
+    }
+  }
+
+  printf("FOV comparison, radius %u, %u viewers\n", r, viewer_num);
+  printf("  cells seen per viewer: bresenham %.1f, shadowcast %.1f, both %.1f\n",
+         (double)bresenham_cells / viewer_num,
+         (double)shadowcast_cells / viewer_num,
+         (double)both_cells / viewer_num);
+  printf("  asymmetric pairs within %u: bresenham %.2f%%, shadowcast %.2f%% of %lu\n",
+         r/2,
+         100.0 * bresenham_asymmetric / pairs,
+         100.0 * shadowcast_asymmetric / pairs,
+         pairs);
+}
+
+static void bench_fov_batch() {
+  printf("FOVBatch::compute vs. BresenhamFOV::update per viewer, 256x256 troll_forest, radius 15\n");
+  printf("%8s %14s %14s %14s %8s\n", "viewers", "one by one ms", "batch ms", "pooled ms", "threads");
+
+  const unsigned int size = 256;
+  auto opacity = level_opacity(game::worldgen::troll_forest(size, Vec2u(size, size)));
+
+  std::mt19937 gen(1);
+  ThreadPool pool;
+
+  for(unsigned int viewer_num : { 64, 256, 1024 }) {
+    std::vector<FOVBatch::Viewer> viewers;
+    while(viewers.size() < viewer_num) {
+      Vec2i p(gen() % size, gen() % size);
+      if(opacity[p] == 0) {
+        viewers.push_back(FOVBatch::Viewer{ p, 15 });
+      }
+    }
+
+    const unsigned int reps = 8;
+
+    // each has built its own ray table before timing starts
+    std::vector<BresenhamFOV> fovs(viewer_num);
+    for(unsigned int i = 0 ; i < viewer_num ; i ++) {
+      fovs[i].update(opacity, viewers[i].pos, viewers[i].radius);
+    }
+    auto t0 = Clock::now();
+    for(unsigned int k = 0 ; k < reps ; k ++) {
+      for(unsigned int i = 0 ; i < viewer_num ; i ++) {
+        fovs[i].update(opacity, viewers[i].pos, viewers[i].radius);
+      }
+    }
+    double single_ms = elapsed_ms(t0) / reps;
+
+    FOVBatch batch;
+    batch.compute(opacity, viewers);
+    t0 = Clock::now();
+    for(unsigned int k = 0 ; k < reps ; k ++) {
+      batch.compute(opacity, viewers);
+    }
+    double batch_ms = elapsed_ms(t0) / reps;
+
+    batch.compute(opacity, viewers, &pool);
+    t0 = Clock::now();
+    for(unsigned int k = 0 ; k < reps ; k ++) {
+      batch.compute(opacity, viewers, &pool);
+    }
+    double pooled_ms = elapsed_ms(t0) / reps;
+
+    printf("%8u %14.3f %14.3f %14.3f %8u\n",
+           viewer_num, single_ms, batch_ms, pooled_ms, pool.size());
+  }
+}
+
+static void bench_turns() {
+  printf("TurnScheduler::tick vs. walking Level::objects, as many trees as actors\n");
+  printf("%8s %14s %14s %14s %14s\n",
+         "actors", "map walk us", "tick us", "round us", "1/10 tick us");
+
+  for(unsigned int actor_num : { 1000, 10000, 100000 }) {
+    game::Level level;
+    for(unsigned int i = 0 ; i < 2*actor_num ; i ++) {
+      auto & o = level.objects[level.new_object_id()];
+      o.set_has_turn(i % 2 == 0);
+    }
+    level.reindex();
+
+    game::TurnScheduler turns;
+    turns.reset(level);
+
+    const unsigned int reps = 100;
+
+    // what step_environment did: visit every object in the map
+    std::vector<int> energies(2*actor_num + 1);
+    auto t0 = Clock::now();
+    for(unsigned int k = 0 ; k < reps ; k ++) {
+      for(auto & entry : level.objects) {
+        energies[entry.id] += 10;
+      }
+    }
+    double walk_us = elapsed_ms(t0) * 1000.0 / reps;
+
+    // a tick after every actor has spent its energy, so every actor joins
+    // the heap again, and the round of turns that follows it
+    double tick_ms = 0.0;
+    double round_ms = 0.0;
+    for(unsigned int k = 0 ; k < reps ; k ++) {
+      t0 = Clock::now();
+      turns.tick(10);
+      tick_ms += elapsed_ms(t0);
+
+      t0 = Clock::now();
+      while(Id id = turns.next()) {
+        turns.use(id, 10);
+      }
+      round_ms += elapsed_ms(t0);
+    }
+
+    // a tick after only a tenth of the actors have acted; the rest are
+    // still ready, and the tick doesn't visit them
+    double sparse_tick_ms = 0.0;
+    turns.tick(10);
+    for(unsigned int k = 0 ; k < reps ; k ++) {
+      for(unsigned int i = 0 ; i < actor_num / 10 ; i ++) {
+        turns.use(turns.next(), 10);
+      }
+
+      t0 = Clock::now();
+      turns.tick(10);
+      sparse_tick_ms += elapsed_ms(t0);
+    }
+
+    printf("%8u %14.2f %14.2f %14.2f %14.2f\n",
+           actor_num, walk_us, tick_ms * 1000.0 / reps, round_ms * 1000.0 / reps,
+           sparse_tick_ms * 1000.0 / reps);
+  }
+}
+
+static void bench_tiles() {
+  printf("Level::tiles, troll_forest\n");
+  printf("%10s %8s %12s %16s\n", "size", "types", "bytes/cell", "glyph ns/cell");
+
+  for(unsigned int size : { 256, 1024 }) {
+    auto level = game::worldgen::troll_forest(size, Vec2u(size, size));
+
+    // each cell's type id, plus the types themselves spread over the cells
+    unsigned int cell_num = size*size;
+    double bytes = sizeof(game::TileId)*cell_num +
+                   (sizeof(game::Tile) + sizeof(game::Glyph))*level.tile_types.size();
+
+    const unsigned int reps = 16;
+    unsigned int checksum = 0;
+    auto t0 = Clock::now();
+    for(unsigned int k = 0 ; k < reps ; k ++) {
+      for(unsigned int y = 0 ; y < size ; y ++) {
+        for(unsigned int x = 0 ; x < size ; x ++) {
+          checksum += level.tile_glyph(Vec2i(x, y)).index;
+        }
+      }
+    }
+    double glyph_ns = elapsed_ms(t0) * 1e6 / reps / cell_num;
+
+    printf("%4ux%-5u %8u %12.2f %16.2f\n",
+           size, size, level.tile_types.size(), bytes / cell_num, glyph_ns);
+    if(checksum == 0) { printf("no glyphs?\n"); }
+  }
+
+  // a full screen of the game's own level, as the main loop draws it
+  game::World world;
+  game::Game game(world);
+
+  const unsigned int reps = 1000;
+  Rect2i roi(Vec2i(-25, -8), Vec2i(80, 45));
+  auto t0 = Clock::now();
+  for(unsigned int k = 0 ; k < reps ; k ++) {
+    game.draw(roi);
+  }
+  printf("Game::draw, %dx%d cells: %.2f us\n",
+         roi.size.x, roi.size.y, elapsed_ms(t0) * 1000.0 / reps);
+}
+
+static void bench_levels() {
+  printf("troll_forest create and destroy\n");
+  printf("%10s %10s %12s %12s %10s\n", "size", "objects", "create ms", "destroy ms", "blocks");
+
+  for(unsigned int size : { 256, 1024 }) {
+    auto t0 = Clock::now();
+    std::unique_ptr<game::Level> level(new game::Level(
+      game::worldgen::troll_forest(size, Vec2u(size, size))
+    ));
+    double create_ms = elapsed_ms(t0);
+
+    unsigned int object_num = level->objects.size();
+    unsigned int block_num = level->parts.block_count();
+
+    t0 = Clock::now();
+    level.reset();
+    double destroy_ms = elapsed_ms(t0);
+
+    printf("%4ux%-5u %10u %12.2f %12.2f %10u\n",
+           size, size, object_num, create_ms, destroy_ms, block_num);
+  }
+}
+
+static void bench_game_step() {
+  printf("Game::step, troll_forest sized for about as many objects, and\n"
+         "derived maps brought up to date per step\n");
+  printf("%8s %10s %10s %12s %8s %8s %8s\n",
+         "target", "size", "objects", "step us", "walk", "player", "missile");
+
+  game::World world;
+
+  // a 30x30 forest holds about 360 objects
+  for(unsigned int object_num : { 100, 1000, 10000 }) {
+    unsigned int size = 30 * std::sqrt(object_num / 360.0);
+    auto level = game::worldgen::troll_forest(size, Vec2u(size, size));
+    unsigned int level_object_num = level.objects.size();
+    game::Game game(world, std::move(level));
+
+    // the same run of turns for every container
+    srand(1);
+    const unsigned int steps = 20000;
+    game::Game::RecomputeCounts total;
+    auto t0 = Clock::now();
+    for(unsigned int i = 0 ; i < steps ; i ++) {
+      game.step();
+
+      auto & counts = game.recompute_counts();
+      total.walk_costs += counts.walk_costs;
+      total.player_walk_distances += counts.player_walk_distances;
+      total.missile_distances += counts.missile_distances;
+    }
+    double step_us = elapsed_ms(t0) * 1000.0 / steps;
+    game.clear_draw_events();
+
+    printf("%8u %4ux%-5u %10u %12.2f %8.3f %8.3f %8.3f\n",
+           object_num, size, size, level_object_num, step_us,
+           (double)total.walk_costs / steps,
+           (double)total.player_walk_distances / steps,
+           (double)total.missile_distances / steps);
+  }
+}
+
+int main(int argc, char ** argv) {
+  bench_dijkstra();
+  bench_dijkstra_batch();
+  bench_chamfer();
+  bench_astar();
+  bench_cluster_graph();
+  bench_path_cache();
+  bench_fov();
+  bench_fov_batch();
+  bench_turns();
+  bench_tiles();
+  bench_levels();
+  bench_game_step();
+  return 0;
+}
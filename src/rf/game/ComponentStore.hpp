@@ -0,0 +1,118 @@
+#ifndef RF_GAME_COMPONENTSTORE_HPP
+#define RF_GAME_COMPONENTSTORE_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <rf/util/Vec2.hpp>
+#include <rf/game/types.hpp>
+#include <rf/game/Glyph.hpp>
+
+namespace rf {
+  namespace game {
+    // One component of type T for any number of objects, kept in a dense
+    // array alongside the ids it belongs to. Lookups by id go through a table
+    // of slots; iteration walks the arrays front to back. Removal moves the
+    // last component into the hole, so order is not kept.
+    template <typename T>
+    class ComponentStore {
+      public:
+      bool has(Id id) const {
+        return id < slots.size() && slots[id] != no_slot;
+      }
+      T * get(Id id) {
+        return has(id) ? &_values[slots[id]] : nullptr;
+      }
+      const T * get(Id id) const {
+        return has(id) ? &_values[slots[id]] : nullptr;
+      }
+
+      // adds a component to `id`, or replaces the one it has
+      void set(Id id, const T & value) {
+        if(has(id)) {
+          _values[slots[id]] = value;
+          return;
+        }
+        if(slots.size() <= id) {
+          slots.resize(id + 1, no_slot);
+        }
+        slots[id] = _ids.size();
+        _ids.push_back(id);
+        _values.push_back(value);
+      }
+      void remove(Id id) {
+        if(!has(id)) { return; }
+
+        uint32_t slot = slots[id];
+        slots[id] = no_slot;
+
+        Id last = _ids.back();
+        if(last != id) {
+          _ids[slot] = last;
+          _values[slot] = std::move(_values.back());
+          slots[last] = slot;
+        }
+        _ids.pop_back();
+        _values.pop_back();
+      }
+      void clear() {
+        _ids.clear();
+        _values.clear();
+        slots.clear();
+      }
+
+      unsigned int size() const { return _ids.size(); }
+      // ids()[i] owns values()[i]
+      const std::vector<Id> & ids() const { return _ids; }
+      const std::vector<T> & values() const { return _values; }
+      std::vector<T> & values() { return _values; }
+
+      // calls fn(id, component) for every component, in storage order
+      template <typename Fn>
+      void for_each(Fn fn) {
+        for(unsigned int i = 0 ; i < _ids.size() ; i ++) {
+          fn(_ids[i], _values[i]);
+        }
+      }
+      template <typename Fn>
+      void for_each(Fn fn) const {
+        for(unsigned int i = 0 ; i < _ids.size() ; i ++) {
+          fn(_ids[i], _values[i]);
+        }
+      }
+
+      private:
+      static constexpr uint32_t no_slot = 0xFFFFFFFF;
+
+      std::vector<Id> _ids;
+      std::vector<T> _values;
+      std::vector<uint32_t> slots;
+    };
+
+    template <typename T>
+    constexpr uint32_t ComponentStore<T>::no_slot;
+
+    // The components of the objects on a level
+    struct Components {
+      // where each object is filed in the level's index of cells
+      ComponentStore<Vec2i> positions;
+      // for objects drawn with one fixed glyph
+      ComponentStore<Glyph> glyphs;
+
+      void remove(Id id) {
+        positions.remove(id);
+        detach(id);
+      }
+      // removes what the object's parts attached, keeping its position
+      void detach(Id id) {
+        glyphs.remove(id);
+      }
+      void clear() {
+        positions.clear();
+        glyphs.clear();
+      }
+    };
+  }
+}
+
+#endif
@@ -1,23 +1,35 @@
 
 #include "Game.hpp"
 
+#include <rf/util/Log.hpp>
+
 #include <cassert>
 #include <limits>
+#include <algorithm>
 
 namespace rf {
   namespace game {
+    static LogTopic & game_topic = logtopic("game");
+
     Game::Game(World & world)
+      : Game(world, world.render(1)) {
+    }
+    Game::Game(World & world, Level && level)
       : world(world) {
       env.player_level_id = 1;
       env.player_object_id = 1;
 
-      env.level = world.render(env.player_level_id);
+      env.level = std::move(level);
+      env.turns.reset(env.level);
 
+      // walk costs are 1 or impassable
+      env.level_dijkstra.set_queue_mode(DijkstraMap::BUCKET);
+
+      update_opacity();
       update_player_fov();
 
       update_walk_costs();
-      update_player_walk_distances();
-      update_missile_distances();
+      update_distance_maps();
     }
     Game::~Game() {
       clear_draw_events();
@@ -26,52 +38,39 @@ namespace rf {
     void Game::save() const {
     }
 
-    SceneState Game::draw(Rect2i roi) const {
+    SceneState Game::draw(Rect2i roi) {
+      refresh_player_fov();
+
       SceneState st;
 
       st.cells.resize(roi.size);
 
-      for(unsigned int j = 0 ; j < roi.size.y ; j ++) {
-        for(unsigned int i = 0 ; i < roi.size.x ; i ++) {
-          Vec2u pi(i, j);
-          Vec2i p(pi + roi.pos);
+      // player_fov is a BresenhamFOV, which is final, so this makes no
+      // virtual call per cell; objects are found through the level's index
+      env.player_fov.for_each_visible(roi, [&](Vec2i p) {
+        auto & cell = st.cells[Vec2u(p - roi.pos)];
 
-          // only draw if visible
-          if(env.player_fov.is_visible(p)) {
-            auto & cell = st.cells[pi];
-
-            if(p.x >= 0 && p.y >= 0 && env.level.tiles.valid(p)) {
-              auto & tile = env.level.tiles[p];
-              cell.tile.glyph = tile.glyph();
-            } else {
-              cell.tile.glyph = Glyph(0, Color());
-            }
-          }
+        if(p.x >= 0 && p.y >= 0 && env.level.tiles.valid(p)) {
+          cell.tile.glyph = env.level.tile_glyph(p);
+        } else {
+          cell.tile.glyph = Glyph(0, Color());
         }
-      }
 
-      for(auto & kvpair : env.level.objects) {
-        auto id = kvpair.first;
-        auto & o = kvpair.second;
-
-        // only draw if visible
-        if(env.player_fov.is_visible(o.pos())) {
-          // check to make sure the object will fit on screen
-          Vec2i pi = o.pos() - roi.pos;
-
-          if(pi.x >= 0 && pi.y >= 0 && st.cells.valid(pi)) {
-            auto & cell = st.cells[pi];
-            cell.objects.emplace_back();
-            cell.objects.back().glyph = o.glyph();
-            cell.objects.back().object_id = id;
-          }
+        for(auto id : env.level.objects_at(p)) {
+          // fixed glyphs come straight from the components; anything else
+          // asks the object's handlers
+          auto * glyph = env.level.components.glyphs.get(id);
+          cell.objects.emplace_back();
+          cell.objects.back().glyph = glyph ? *glyph : env.level.objects.at(id).glyph();
+          cell.objects.back().object_id = id;
         }
-      }
+      });
 
       return st;
     }
 
     void Game::step() {
+      _recompute_counts = RecomputeCounts();
       Id object_id = next_object_turn();
 
       if(object_id == 0) {
@@ -82,6 +81,7 @@ namespace rf {
       }
     }
     void Game::wait() {
+      _recompute_counts = RecomputeCounts();
       Id object_id = next_object_turn();
 
       if(object_id == 0) {
@@ -96,6 +96,7 @@ namespace rf {
       }
     }
     void Game::move(Vec2i delta) {
+      _recompute_counts = RecomputeCounts();
       Id object_id = next_object_turn();
 
       if(object_id == 0) {
@@ -111,14 +112,7 @@ namespace rf {
     }
 
     Id Game::next_object_turn() const {
-      for(auto & kvpair : env.level.objects) {
-        auto & id = kvpair.first;
-        auto & object = kvpair.second;
-        if(object.has_turn() && object.turn_energy() > 0) {
-          return id;
-        }
-      }
-      return 0;
+      return env.turns.next();
     }
     bool Game::is_player_turn() const {
       Id turn_id = next_object_turn();
@@ -148,10 +142,7 @@ namespace rf {
     }
 
     void Game::step_environment() {
-      for(auto & kvpair : env.level.objects) {
-        auto & o = kvpair.second;
-        o.add_turn_energy(10);
-      }
+      env.turns.tick(10);
 
       if((rand() % 30) == 0) {
         auto & lv = env.level;
@@ -159,12 +150,18 @@ namespace rf {
 
         //printf("Spawning new orc (%u)\n", id);
         auto & orc = lv.objects[id];
-        orc.add(new BasicObjectGlyph(Glyph(0 + 1*16, Color(0xFF, 0xCC, 0x99))));
+        orc.add(lv.parts.make<BasicObjectGlyph>(Glyph(0 + 1*16, Color(0xFF, 0xCC, 0x99))));
+        orc.set_id(id);
         orc.set_pos(Vec2i(rand() % lv.tiles.size().x, rand() % lv.tiles.size().y));
         orc.set_has_turn(true);
+        lv.reindex(orc);
+
+        notify_create(orc);
       }
     }
     void Game::auto_turn(Object & object) {
+      refresh_player_walk_distances();
+
       std::vector<Vec2i> min_deltas;
       int min_distance = DijkstraMap::infinity;
       for(int y = -1 ; y <= 1 ; y ++) {
@@ -216,7 +213,8 @@ namespace rf {
     }
 
     void Game::wait(Object & object) {
-      object.use_turn_energy(10);
+      env.turns.use(object.id(), 10);
+      refresh_missile_distances();
 
       auto start_pos = object.pos();
 
@@ -278,70 +276,191 @@ namespace rf {
       if(!is_occupied(destination)) {
         if(destination.x >= 0 && destination.x < env.level.tiles.size().x &&
            destination.y >= 0 && destination.y < env.level.tiles.size().y) {
+          Vec2i from = object.pos();
           object.set_pos(destination);
-          notify_move(object);
+          env.level.reindex(object);
+          notify_move(object, from);
         }
       }
-      object.use_turn_energy(10);
+      env.turns.use(object.id(), 10);
     }
 
+    // trees, rocks, bones and the like block sight; anything that acts doesn't
+    static bool blocks_sight(const Object & object) {
+      return !object.has_turn();
+    }
+
+    void Game::update_opacity() {
+      env.opacity.resize(env.level.tiles.size());
+      env.opacity.fill(0);
+      env.opaque_counts.resize(env.level.tiles.size());
+      env.opaque_counts.fill(0);
+
+      for(auto & entry : env.level.objects) {
+        auto & obj = entry.object;
+        if(blocks_sight(obj)) {
+          env.opaque_counts.at(obj.pos()) ++;
+          env.opacity.at(obj.pos()) = 1;
+        }
+      }
+
+      env.player_fovs.clear();
+      player_fov_stale = true;
+    }
+    void Game::add_opacity(const Object & object, Vec2i pos) {
+      if(blocks_sight(object)) {
+        if(env.opaque_counts.at(pos) ++ == 0) {
+          env.opacity.at(pos) = 1;
+          env.player_fovs.notify_changed(pos);
+          player_fov_stale |= env.player_fov.covers(pos);
+        }
+      }
+    }
+    void Game::remove_opacity(const Object & object, Vec2i pos) {
+      if(blocks_sight(object)) {
+        if(-- env.opaque_counts.at(pos) == 0) {
+          env.opacity.at(pos) = 0;
+          env.player_fovs.notify_changed(pos);
+          player_fov_stale |= env.player_fov.covers(pos);
+        }
+      }
+    }
     void Game::update_player_fov() {
       if(env.player_object_id) {
-        Map<unsigned int> tile_opacity;
-        tile_opacity.resize(env.level.tiles.size());
-        tile_opacity.fill(0);
-        for(auto & kvpair : env.level.objects) {
-          auto & obj = kvpair.second;
-          if(!obj.has_turn()) {
-            tile_opacity.at(obj.pos()) = 1;
-          }
-        }
         Object & player_obj = env.level.objects.at(env.player_object_id);
-        env.player_fov.update(tile_opacity, player_obj.pos(), 15);
+        env.player_fov = env.player_fovs.update(env.opacity, player_obj.pos(), 15);
+
+        auto & cache = env.player_fovs;
+        unsigned long lookups = cache.hit_count() + cache.miss_count();
+        if(lookups == 1000) {
+          game_topic.logf("player FOV cache: %lu hits in %lu lookups (%.1f%%)",
+                          cache.hit_count(), lookups, 100.0 * cache.hit_count() / lookups);
+          cache.reset_counters();
+        }
       }
+      player_fov_stale = false;
     }
     void Game::update_walk_costs() {
       env.walk_costs.resize(env.level.tiles.size());
       env.walk_costs.fill(1);
 
-      for(auto & kvpair : env.level.objects) {
-        auto & obj = kvpair.second;
+      for(auto & entry : env.level.objects) {
+        auto & obj = entry.object;
         //env.objects[obj.pos()] = &obj;
-        env.walk_costs.at(obj.pos()) = 0xFFFFFFFF;
+        env.walk_costs.at(obj.pos()) = DijkstraMap::impassable;
       }
     }
-    void Game::update_player_walk_distances() {
+    void Game::update_walk_costs(const std::vector<Vec2u> & changed) {
+      for(auto & pos : changed) {
+        bool empty = env.level.objects_at(pos).empty();
+        env.walk_costs.at(pos) = empty ? 1 : DijkstraMap::impassable;
+      }
+    }
+    void Game::update_distance_maps() {
+      // all distance maps share walk_costs, and are computed as one batch
+      std::vector<std::vector<DijkstraMap::Goal>> starts;
+
+      starts.emplace_back();
+      for(auto & pos : missile_goals()) {
+        starts.back().push_back(std::make_pair(pos, 0));
+      }
+
+      if(env.player_object_id) {
+        Object & object = env.level.objects.at(env.player_object_id);
+        starts.emplace_back();
+        starts.back().push_back(std::make_pair(Vec2u(object.pos()), 0));
+      }
+
+      std::vector<Map<DijkstraMap::Distance>> maps;
+      env.level_dijkstra.compute_batch(maps, env.walk_costs, starts);
+
+      env.missile_distances = std::move(maps[0]);
+      if(env.player_object_id) {
+        env.player_walk_distances = std::move(maps[1]);
+      }
+    }
+    void Game::update_player_walk_distances(const std::vector<Vec2u> & changed) {
       if(env.player_object_id) {
         Object & object = env.level.objects.at(env.player_object_id);
-        env.level_dijkstra.compute(
+        env.level_dijkstra.update(
             env.player_walk_distances,
             env.walk_costs,
-            object.pos()
+            object.pos(),
+            changed
         );
       }
     }
-    void Game::update_missile_distances() {
-      std::vector<Vec2u> goals;
+    void Game::update_missile_distances(const std::vector<Vec2u> & changed) {
+      env.level_dijkstra.update(
+          env.missile_distances,
+          env.walk_costs,
+          missile_goals(),
+          changed
+      );
+    }
+
+    // sorts `cells` and drops repeats, as a cell may change many times
+    // between reads
+    static void sort_unique(std::vector<Vec2u> & cells) {
+      std::sort(cells.begin(), cells.end(), [](const Vec2u & a, const Vec2u & b) {
+        return a.y < b.y || (a.y == b.y && a.x < b.x);
+      });
+      cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+    }
+
+    void Game::refresh_player_fov() {
+      if(player_fov_stale) {
+        update_player_fov();
+        _recompute_counts.player_fov ++;
+      }
+    }
+    void Game::refresh_walk_costs() {
+      if(walk_costs_changed.empty()) { return; }
 
-      for(auto & kvpair : env.level.objects) {
-        auto id = kvpair.first;
-        auto & obj = kvpair.second;
+      sort_unique(walk_costs_changed);
+      update_walk_costs(walk_costs_changed);
+      _recompute_counts.walk_costs ++;
 
-        if(id != env.player_object_id && obj.has_turn()) {
-          goals.push_back(obj.pos());
+      for(auto * changed : { &player_walk_distances_changed, &missile_distances_changed }) {
+        changed->insert(changed->end(), walk_costs_changed.begin(), walk_costs_changed.end());
+      }
+      walk_costs_changed.clear();
+    }
+    void Game::refresh_player_walk_distances() {
+      refresh_walk_costs();
+      if(player_walk_distances_changed.empty()) { return; }
+
+      sort_unique(player_walk_distances_changed);
+      update_player_walk_distances(player_walk_distances_changed);
+      _recompute_counts.player_walk_distances ++;
+      player_walk_distances_changed.clear();
+    }
+    void Game::refresh_missile_distances() {
+      refresh_walk_costs();
+      if(missile_distances_changed.empty()) { return; }
+
+      sort_unique(missile_distances_changed);
+      update_missile_distances(missile_distances_changed);
+      _recompute_counts.missile_distances ++;
+      missile_distances_changed.clear();
+    }
+
+    std::vector<Vec2u> Game::missile_goals() const {
+      std::vector<Vec2u> goals;
+
+      // every actor is in the scheduler, and its position in the components
+      auto & positions = env.level.components.positions;
+      for(auto id : env.turns.actors()) {
+        if(id != env.player_object_id) {
+          goals.push_back(*positions.get(id));
         }
       }
 
-      env.level_dijkstra.compute(
-          env.missile_distances,
-          env.walk_costs,
-          goals
-      );
+      return goals;
     }
     bool Game::is_occupied(Vec2i pos) {
-      for(auto & kvpair : env.level.objects) {
-        auto & obj = kvpair.second;
-        if(obj.pos() == pos && !obj.on_ground()) {
+      for(auto id : env.level.objects_at(pos)) {
+        if(!env.level.objects.at(id).on_ground()) {
           return true;
         }
       }
@@ -349,53 +468,61 @@ namespace rf {
     }
     void Game::crush(Vec2i pos, int radius) {
       std::vector<Id> kill_list;
-      for(auto & kvpair : env.level.objects) {
-        auto id = kvpair.first;
-        auto & o = kvpair.second;
-        if(id == env.player_object_id) { continue; } // don't harm the player
-        if(o.pos().x < pos.x - radius) { continue; }
-        if(o.pos().x > pos.x + radius) { continue; }
-        if(o.pos().y < pos.y - radius) { continue; }
-        if(o.pos().y > pos.y + radius) { continue; }
-        kill_list.push_back(id);
-      }
+      env.level.objects_near(kill_list, pos, radius);
+      // don't harm the player
+      kill_list.erase(std::remove(kill_list.begin(), kill_list.end(), env.player_object_id),
+                      kill_list.end());
 
       for(auto & id : kill_list) {
         auto & lv = env.level;
-        auto & obj = lv.objects[id];
-
-        if(obj.has_turn()) {
-          auto & bones = lv.objects[lv.new_object_id()];
-          bones.add(new BasicObjectGlyph(Glyph(10 + 8*16, Color(0xCC, 0xCC, 0xCC))));
-          bones.set_pos(obj.pos());
+        Vec2i pos = lv.objects.at(id).pos();
+
+        if(lv.objects.at(id).has_turn()) {
+          auto bones_id = lv.new_object_id();
+          auto & bones = lv.objects[bones_id];
+          bones.add(lv.parts.make<BasicObjectGlyph>(Glyph(10 + 8*16, Color(0xCC, 0xCC, 0xCC))));
+          bones.set_id(bones_id);
+          bones.set_pos(pos);
           bones.set_on_ground(true);
+          lv.reindex(bones);
+          add_opacity(bones, bones.pos());
         }
 
+        // looked up again, as adding the bones may have moved it
+        auto & obj = lv.objects.at(id);
+        remove_opacity(obj, pos);
+        lv.unindex(obj);
+        env.turns.remove(id);
         env.level.objects.erase(id);
-        notify_death(id);
+        notify_death(id, pos);
         //message("Ka-BOOOM!");
       }
     }
 
-    void Game::notify_death(Id object_id) {
+    void Game::notify_create(Object & object) {
+      env.turns.add(object);
+      add_opacity(object, object.pos());
+      // dijkstra maps need repair around the new object
+      walk_costs_changed.push_back(object.pos());
+    }
+    void Game::notify_death(Id object_id, Vec2i pos) {
       if(object_id == env.player_object_id) {
         env.player_object_id = 0;
       }
 
-      // recompute player fov
-      update_player_fov();
-      // recompute dijkstra maps based on goals
-      update_walk_costs();
-      update_player_walk_distances();
-      update_missile_distances();
+      // opacity was already updated before the object was erased; dijkstra
+      // maps need repair around the dead object
+      walk_costs_changed.push_back(pos);
     }
-    void Game::notify_move(Object & object) {
-      // recompute player fov
-      update_player_fov();
-      // recompute dijkstra maps based on goals
-      update_walk_costs();
-      update_player_walk_distances();
-      update_missile_distances();
+    void Game::notify_move(Object & object, Vec2i from) {
+      remove_opacity(object, from);
+      add_opacity(object, object.pos());
+      if(env.player_object_id && object.id() == env.player_object_id) {
+        player_fov_stale = true;
+      }
+      // dijkstra maps need repair around the old and new positions
+      walk_costs_changed.push_back(from);
+      walk_costs_changed.push_back(object.pos());
     }
 
     void Game::message(const std::string & str) {
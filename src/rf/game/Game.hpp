@@ -13,10 +13,12 @@
 #include <rf/game/Tile.hpp>
 #include <rf/game/Level.hpp>
 #include <rf/game/World.hpp>
+#include <rf/game/TurnScheduler.hpp>
 #include <rf/util/Vec2.hpp>
 #include <rf/util/Map.hpp>
 #include <rf/util/Dijkstra.hpp>
 #include <rf/util/FOV.hpp>
+#include <rf/util/FOVCache.hpp>
 
 namespace rf {
   namespace game {
@@ -55,10 +57,18 @@ namespace rf {
       Id player_object_id = 0;
 
       Level level;
+      // the objects on level which may act next
+      TurnScheduler turns;
 
       DijkstraMap level_dijkstra;
 
       BresenhamFOV player_fov;
+      // recent player FOVs over opacity, for when the player steps back
+      FOVCache player_fovs;
+      // 1 where an object blocks sight, 0 elsewhere, and the number of such
+      // objects in each cell; kept up to date as objects come and go
+      Map<unsigned int> opacity;
+      Map<unsigned int> opaque_counts;
 
       Map<unsigned int> walk_costs;
       Map<int> player_walk_distances;
@@ -69,13 +79,17 @@ namespace rf {
     class Game {
       public:
       Game(World & world);
+      // plays `level` in place of the world's first level; object 1 is the
+      // player
+      Game(World & world, Level && level);
       Game(const Game & other) = delete;
       Game & operator=(const Game & other) = delete;
       ~Game();
 
       void save() const;
 
-      SceneState draw(Rect2i roi) const;
+      // brings the player's FOV up to date first, if it is stale
+      SceneState draw(Rect2i roi);
 
       void step();
       void wait();
@@ -88,26 +102,62 @@ namespace rf {
       void handle_draw_events(DrawEventVisitor & v);
       void clear_draw_events();
 
+      // How many times each derived map was brought up to date since the
+      // last step, wait or move began. Maps are only brought up to date when
+      // read, however many changes came before.
+      struct RecomputeCounts {
+        unsigned int walk_costs = 0;
+        unsigned int player_walk_distances = 0;
+        unsigned int missile_distances = 0;
+        unsigned int player_fov = 0;
+      };
+      const RecomputeCounts & recompute_counts() const { return _recompute_counts; }
+
       private:
       World & world;
       Environment env;
 
       std::deque<DrawEvent *> draw_events;
 
+      // set when the player moves, or sight is blocked or unblocked near them
+      bool player_fov_stale = false;
+      // cells changed since each map was last brought up to date; walk costs
+      // pass theirs on to the distance maps when they are
+      std::vector<Vec2u> walk_costs_changed;
+      std::vector<Vec2u> player_walk_distances_changed;
+      std::vector<Vec2u> missile_distances_changed;
+
+      RecomputeCounts _recompute_counts;
+
       void step_environment();
       void auto_turn(Object & object);
       void wait(Object & object);
       void walk(Object & object, Vec2i delta);
 
+      void update_opacity();
+      void add_opacity(const Object & object, Vec2i pos);
+      void remove_opacity(const Object & object, Vec2i pos);
       void update_player_fov();
       void update_walk_costs();
-      void update_player_walk_distances();
-      void update_missile_distances();
+      void update_walk_costs(const std::vector<Vec2u> & changed);
+      void update_distance_maps();
+      void update_player_walk_distances(const std::vector<Vec2u> & changed);
+      void update_missile_distances(const std::vector<Vec2u> & changed);
+
+      // bring each map up to date with the changes since it last was, if any
+      void refresh_player_fov();
+      void refresh_walk_costs();
+      void refresh_player_walk_distances();
+      void refresh_missile_distances();
+
+      std::vector<Vec2u> missile_goals() const;
       bool is_occupied(Vec2i pos);
       void crush(Vec2i pos, int radius);
 
-      void notify_death(Id object_id);
-      void notify_move(Object & object);
+      // mark the derived maps stale around the objects concerned
+      void notify_create(Object & object);
+      void notify_death(Id object_id, Vec2i pos);
+      void notify_move(Object & object, Vec2i from);
 
       void message(const std::string & str);
     };
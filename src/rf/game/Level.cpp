@@ -1,11 +1,84 @@
 
 #include "Level.hpp"
 
+#include <algorithm>
+
 namespace rf {
   namespace game {
     Id Level::new_object_id() {
       return ++last_id;
     }
+
+    void Level::reindex() {
+      cell_objects.clear();
+      cell_objects.resize(tiles.size());
+      components.clear();
+
+      // objects are visited in id order, so every cell comes out sorted
+      for(auto & entry : objects) {
+        auto & object = entry.object;
+        object.set_id(entry.id);
+        if(cell_objects.valid(object.pos())) {
+          cell_objects[object.pos()].push_back(entry.id);
+          components.positions.set(entry.id, object.pos());
+          object.attach(components);
+        }
+      }
+    }
+    void Level::reindex(Object & object) {
+      Id id = object.id();
+      Vec2i * pos = components.positions.get(id);
+
+      if(pos) {
+        if(*pos == object.pos()) {
+          // parts may have been added since
+          object.attach(components);
+          return;
+        }
+        auto & ids = cell_objects[*pos];
+        ids.erase(std::lower_bound(ids.begin(), ids.end(), id));
+      }
+
+      if(cell_objects.valid(object.pos())) {
+        auto & ids = cell_objects[object.pos()];
+        ids.insert(std::upper_bound(ids.begin(), ids.end(), id), id);
+        components.positions.set(id, object.pos());
+        object.attach(components);
+      } else {
+        components.remove(id);
+      }
+    }
+    void Level::unindex(Object & object) {
+      Id id = object.id();
+      Vec2i * pos = components.positions.get(id);
+      if(!pos) { return; }
+
+      auto & ids = cell_objects[*pos];
+      ids.erase(std::lower_bound(ids.begin(), ids.end(), id));
+      components.remove(id);
+    }
+
+    const std::vector<Id> & Level::objects_at(Vec2i pos) const {
+      static const std::vector<Id> none;
+      if(!cell_objects.valid(pos)) { return none; }
+      return cell_objects[pos];
+    }
+    void Level::objects_near(std::vector<Id> & ids_out, Vec2i pos, int radius) const {
+      ids_out.clear();
+
+      Vec2i size(cell_objects.size());
+      int x0 = std::max(pos.x - radius, 0);
+      int y0 = std::max(pos.y - radius, 0);
+      int x1 = std::min(pos.x + radius, size.x - 1);
+      int y1 = std::min(pos.y + radius, size.y - 1);
+
+      for(int y = y0 ; y <= y1 ; y ++) {
+        for(int x = x0 ; x <= x1 ; x ++) {
+          auto & ids = cell_objects[Vec2u(x, y)];
+          ids_out.insert(ids_out.end(), ids.begin(), ids.end());
+        }
+      }
+      std::sort(ids_out.begin(), ids_out.end());
+    }
   }
 }
-
@@ -1,11 +1,13 @@
 #ifndef RF_GAME_LEVEL_HPP
 #define RF_GAME_LEVEL_HPP
 
-#include <map>
+#include <vector>
 #include <rf/game/types.hpp>
 #include <rf/game/Tile.hpp>
 #include <rf/game/Object.hpp>
+#include <rf/game/ObjectMap.hpp>
 #include <rf/util/Map.hpp>
+#include <rf/util/Arena.hpp>
 
 namespace rf {
   namespace game {
@@ -21,14 +23,43 @@ namespace rf {
 
       Tick tick = 0;
 
-      Map<Tile> tiles;
-      std::map<Id, Object> objects;
+      // Owns the parts of every tile type and object on the level. Parts of
+      // erased objects stay until the level is destroyed; declared first so
+      // that it outlives everything pointing into it.
+      Arena parts;
+
+      TileTypes tile_types;
+      // the type of each cell, within tile_types
+      Map<TileId> tiles;
+      ObjectMap objects;
+      // dense copies of object data, kept by reindex and unindex
+      Components components;
 
       Id new_object_id() ;
+
+      const Tile & tile(Vec2i pos) const { return tile_types[tiles[pos]]; }
+      const Glyph & tile_glyph(Vec2i pos) const { return tile_types.glyph(tiles[pos]); }
+
+      // Rebuilds the index of objects by cell and the components, and sets
+      // every object's id from its key in `objects`.
+      void reindex();
+      // Files `object` (whose id must be set) under its current position,
+      // after it is created, moves or gains parts, and attaches its
+      // components again.
       void reindex(Object & object);
+      // Removes `object` from the index and components, before it is erased.
+      void unindex(Object & object);
+
+      // ids of the objects at `pos`, in increasing order
+      const std::vector<Id> & objects_at(Vec2i pos) const;
+      // Writes the ids of the objects within `radius` of `pos` (as a square)
+      // into `ids_out`, in increasing order.
+      void objects_near(std::vector<Id> & ids_out, Vec2i pos, int radius) const;
 
       private:
       Id last_id = 0;
+
+      Map<std::vector<Id>> cell_objects;
     };
   }
 }
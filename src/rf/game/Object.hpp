@@ -2,8 +2,10 @@
 #define RF_GAME_OBJECT_HPP
 
 #include <rf/util/Vec2.hpp>
+#include <rf/game/types.hpp>
 #include <rf/game/Glyph.hpp>
 #include <rf/game/Handlers.hpp>
+#include <rf/game/ComponentStore.hpp>
 
 namespace rf {
   namespace game {
@@ -16,6 +18,11 @@ namespace rf {
       void add(MoveHandler & h) { move.push_back(&h); }
       void add(DamageHandler & h) { damage.push_back(&h); }
 
+      // the handler that decides the object's glyph, if any
+      const GlyphHandler * last_glyph() const {
+        return glyph.empty() ? nullptr : glyph.back();
+      }
+
       private:
       std::vector<const GlyphHandler *> glyph;
       std::vector<const DeadHandler *> dead;
@@ -27,12 +34,14 @@ namespace rf {
       friend class Object;
     };
 
-    // attaches handlers, and is serializable ; exists to be deleted when the
-    // object is deleted
+    // attaches handlers, and is serializable ; lives in the arena of the
+    // object's level, and is destroyed with the level
     class ObjectPart {
       public:
       virtual ~ObjectPart() = default;
       virtual void init(ObjectHandlers & oh) {}
+      // adds whatever this part has as plain data to the level's components
+      virtual void attach(Components & c, Id id, const ObjectHandlers & oh) const {}
     };
 
     class BasicObjectGlyph : public ObjectPart {
@@ -50,6 +59,12 @@ namespace rf {
       void init(ObjectHandlers & oh) override {
         oh.add(glyph);
       }
+      // only when no later part overrides the glyph
+      void attach(Components & c, Id id, const ObjectHandlers & oh) const override {
+        if(oh.last_glyph() == &glyph) {
+          c.glyphs.set(id, static_cast<const game::GlyphHandler &>(glyph)());
+        }
+      }
 
       public:
       BasicObjectGlyph(const Glyph & g) : glyph(g) {}
@@ -63,16 +78,29 @@ namespace rf {
       Object & operator=(const Object & other) = delete;
       Object(Object && other) noexcept = default;
       Object & operator=(Object && other) noexcept = default;
-      ~Object() {
-        for(auto & p : parts) {
-          delete p;
-        }
-      }
-      // `p` must be allocated via `operator new`
+      // `p` is not owned by the object, and must outlive it; parts are made
+      // in their level's arena, as `level.parts.make<Part>(...)`. Parts added
+      // to an indexed object reach the components when it is next reindexed.
       void add(ObjectPart * p) {
         parts.push_back(p);
         p->init(handlers);
       }
+      // hands every part's components to `c`, under this object's id,
+      // replacing whatever was attached before
+      void attach(Components & c) const {
+        c.detach(_id);
+        for(auto & p : parts) {
+          p->attach(c, _id, handlers);
+        }
+      }
+
+      // the key of this object in Level::objects, once indexed
+      Id id() const {
+        return _id;
+      }
+      void set_id(Id id) {
+        _id = id;
+      }
 
       Vec2i pos() const {
         return _pos;
@@ -94,15 +122,6 @@ namespace rf {
       void set_has_turn(bool b) {
         _has_turn = b;
       }
-      int turn_energy() const {
-        return _turn_energy;
-      }
-      void add_turn_energy(int amt) {
-        _turn_energy += amt;
-      }
-      void use_turn_energy(int amt) {
-        _turn_energy -= amt;
-      }
 
       bool playable() const { return _playable; }
       void set_playable(bool b) { _playable = b; }
@@ -154,11 +173,12 @@ namespace rf {
 
       ObjectHandlers handlers;
 
+      Id _id = 0;
       Vec2i _pos;
       bool _on_ground = false;
 
+      // turn energy is kept by the TurnScheduler
       bool _has_turn = false;
-      int _turn_energy = 0;
 
       bool _playable = false;
     };
@@ -0,0 +1,94 @@
+
+#include "ObjectMap.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cassert>
+
+namespace rf {
+  namespace game {
+    constexpr uint32_t ObjectMap::no_slot;
+
+    Object & ObjectMap::at(Id id) {
+      if(!contains(id)) { throw std::out_of_range("ObjectMap::at"); }
+      return entries[slots[id]].object;
+    }
+    const Object & ObjectMap::at(Id id) const {
+      if(!contains(id)) { throw std::out_of_range("ObjectMap::at"); }
+      return entries[slots[id]].object;
+    }
+
+    Object & ObjectMap::operator[](Id id) {
+      assert(id != 0);
+
+      if(contains(id)) {
+        return entries[slots[id]].object;
+      }
+
+      // new ids are normally the highest yet, and go on the end
+      if(slots.size() <= id) {
+        slots.resize(id + 1, no_slot);
+        slots[id] = entries.size();
+        entries.emplace_back();
+        entries.back().id = id;
+        return entries.back().object;
+      }
+
+      // otherwise it goes after the last entry with a lower id, and the
+      // entries after that move up a slot
+      auto it = entries.begin();
+      for(auto jt = entries.begin() ; jt != entries.end() ; ++ jt) {
+        if(jt->id != 0) {
+          if(jt->id > id) { break; }
+          it = jt + 1;
+        }
+      }
+      uint32_t slot = it - entries.begin();
+
+      Entry entry;
+      entry.id = id;
+      entries.insert(it, std::move(entry));
+      for(uint32_t s = slot ; s < entries.size() ; s ++) {
+        if(entries[s].id != 0) {
+          slots[entries[s].id] = s;
+        }
+      }
+      return entries[slot].object;
+    }
+
+    void ObjectMap::erase(Id id) {
+      if(!contains(id)) { return; }
+
+      auto & entry = entries[slots[id]];
+      slots[id] = no_slot;
+      entry.id = 0;
+      entry.object = Object();
+      hole_count ++;
+
+      if(2*hole_count >= entries.size()) {
+        compact();
+      }
+    }
+
+    void ObjectMap::clear() {
+      entries.clear();
+      slots.clear();
+      hole_count = 0;
+    }
+
+    void ObjectMap::compact() {
+      uint32_t live = 0;
+      for(uint32_t s = 0 ; s < entries.size() ; s ++) {
+        if(entries[s].id != 0) {
+          if(s != live) {
+            entries[live] = std::move(entries[s]);
+            slots[entries[live].id] = live;
+          }
+          live ++;
+        }
+      }
+      entries.resize(live);
+      hole_count = 0;
+    }
+  }
+}
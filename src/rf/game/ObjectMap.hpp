@@ -0,0 +1,97 @@
+#ifndef RF_GAME_OBJECTMAP_HPP
+#define RF_GAME_OBJECTMAP_HPP
+
+#include <vector>
+#include <cstdint>
+#include <rf/game/types.hpp>
+#include <rf/game/Object.hpp>
+
+namespace rf {
+  namespace game {
+    // The objects of a level by id, in one array kept in increasing id order.
+    // Lookups go through a table of slots indexed by id; iteration walks the
+    // array front to back. Erasing leaves a hole, which iteration skips, and
+    // holes are squeezed out once they fill half the array. As with a
+    // std::vector, inserting or erasing may move objects, so references to
+    // them do not survive either.
+    class ObjectMap {
+      public:
+      struct Entry {
+        // 0 for a hole
+        Id id = 0;
+        Object object;
+      };
+
+      template <typename E>
+      class Iterator {
+        public:
+        Iterator(E * p, E * end) : p(p), end(end) { skip(); }
+
+        E & operator*() const { return *p; }
+        E * operator->() const { return p; }
+        Iterator & operator++() {
+          ++ p;
+          skip();
+          return *this;
+        }
+        bool operator==(const Iterator & other) const { return p == other.p; }
+        bool operator!=(const Iterator & other) const { return p != other.p; }
+
+        private:
+        E * p;
+        E * end;
+
+        void skip() {
+          while(p != end && p->id == 0) { ++ p; }
+        }
+      };
+      typedef Iterator<Entry> iterator;
+      typedef Iterator<const Entry> const_iterator;
+
+      ObjectMap() = default;
+      ObjectMap(const ObjectMap & other) = delete;
+      ObjectMap & operator=(const ObjectMap & other) = delete;
+      ObjectMap(ObjectMap && other) = default;
+      ObjectMap & operator=(ObjectMap && other) = default;
+
+      bool contains(Id id) const {
+        return id < slots.size() && slots[id] != no_slot;
+      }
+      Object * get(Id id) {
+        return contains(id) ? &entries[slots[id]].object : nullptr;
+      }
+      const Object * get(Id id) const {
+        return contains(id) ? &entries[slots[id]].object : nullptr;
+      }
+      // throws std::out_of_range if there is no object `id`, as std::map does
+      Object & at(Id id);
+      const Object & at(Id id) const;
+
+      // the object `id`, inserted if there is none; inserting the highest id
+      // yet takes constant time
+      Object & operator[](Id id);
+      void erase(Id id);
+      void clear();
+
+      unsigned int size() const { return entries.size() - hole_count; }
+      bool empty() const { return size() == 0; }
+
+      iterator begin() { return iterator(entries.data(), entries.data() + entries.size()); }
+      iterator end() { return iterator(entries.data() + entries.size(), entries.data() + entries.size()); }
+      const_iterator begin() const { return const_iterator(entries.data(), entries.data() + entries.size()); }
+      const_iterator end() const { return const_iterator(entries.data() + entries.size(), entries.data() + entries.size()); }
+
+      private:
+      static constexpr uint32_t no_slot = 0xFFFFFFFF;
+
+      std::vector<Entry> entries;
+      // index in entries of each id, or no_slot
+      std::vector<uint32_t> slots;
+      unsigned int hole_count = 0;
+
+      void compact();
+    };
+  }
+}
+
+#endif
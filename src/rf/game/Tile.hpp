@@ -2,6 +2,8 @@
 #define RF_GAME_TILE_HPP
 
 #include <vector>
+#include <cstdint>
+#include <cassert>
 #include <rf/game/Glyph.hpp>
 #include <rf/game/Handlers.hpp>
 
@@ -43,6 +45,7 @@ namespace rf {
       BasicTileGlyph(const Glyph & g) : glyph(g) {}
     };
 
+    // Describes one type of tile, which any number of cells may share
     class Tile {
       std::vector<TilePart *> parts;
 
@@ -54,12 +57,7 @@ namespace rf {
       Tile & operator=(const Tile & other) = delete;
       Tile(Tile && other) noexcept = default;
       Tile & operator=(Tile && other) noexcept = default;
-      ~Tile() {
-        for(auto & p : parts) {
-          delete p;
-        }
-      }
-      // Part must be allocated via `operator new`
+      // `p` is not owned by the tile, and must outlive it, as for Object
       void add(TilePart * p) {
         parts.push_back(p);
         p->init(handlers);
@@ -81,6 +79,39 @@ namespace rf {
         }
       };
     };
+
+    // index of a tile type within a level's TileTypes
+    typedef uint16_t TileId;
+
+    // The types of tile on a level. Cells store only the TileId of their
+    // type, so the parts of a type are allocated once, however many cells
+    // share it. A cell which needs parts of its own is given a type of its
+    // own.
+    class TileTypes {
+      public:
+      static constexpr unsigned int max_count = 0x10000;
+
+      TileId add(Tile && tile) {
+        assert(tiles.size() < max_count);
+        glyphs.push_back(tile.glyph());
+        tiles.push_back(std::move(tile));
+        return tiles.size() - 1;
+      }
+      void clear() {
+        tiles.clear();
+        glyphs.clear();
+      }
+
+      const Tile & operator[](TileId id) const { return tiles[id]; }
+      // the glyph of type `id`, as it was when the type was added
+      const Glyph & glyph(TileId id) const { return glyphs[id]; }
+
+      unsigned int size() const { return tiles.size(); }
+
+      private:
+      std::vector<Tile> tiles;
+      std::vector<Glyph> glyphs;
+    };
   }
 }
 
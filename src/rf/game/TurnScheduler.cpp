@@ -0,0 +1,180 @@
+
+#include "TurnScheduler.hpp"
+
+#include <rf/game/Level.hpp>
+
+#include <cassert>
+#include <algorithm>
+
+namespace rf {
+  namespace game {
+    constexpr uint32_t TurnScheduler::no_index;
+
+    void TurnScheduler::reset(const Level & level) {
+      actor_ids.clear();
+      energies.clear();
+      heap.clear();
+      spent.clear();
+      actor_slots.clear();
+      heap_indices.clear();
+
+      for(auto & entry : level.objects) {
+        add(entry.object);
+      }
+    }
+
+    void TurnScheduler::grow(Id id) {
+      if(actor_slots.size() <= id) {
+        actor_slots.resize(id + 1, no_index);
+        heap_indices.resize(id + 1, no_index);
+      }
+    }
+
+    void TurnScheduler::add(const Object & object) {
+      if(!object.has_turn()) { return; }
+
+      Id id = object.id();
+      grow(id);
+      assert(actor_slots[id] == no_index);
+
+      actor_slots[id] = actor_ids.size();
+      actor_ids.push_back(id);
+      energies.push_back(0);
+      spent.push_back(id);
+    }
+    void TurnScheduler::remove(Id id) {
+      if(id >= actor_slots.size() || actor_slots[id] == no_index) { return; }
+
+      heap_remove(id);
+
+      // move the last actor into the vacated slot
+      uint32_t slot = actor_slots[id];
+      actor_slots[id] = no_index;
+
+      Id last = actor_ids.back();
+      if(last != id) {
+        actor_ids[slot] = last;
+        energies[slot] = energies.back();
+        actor_slots[last] = slot;
+      }
+      actor_ids.pop_back();
+      energies.pop_back();
+    }
+
+    void TurnScheduler::tick(int amount) {
+      assert(amount > 0);
+
+      int * e = energies.data();
+      unsigned int n = energies.size();
+
+      for(unsigned int i = 0 ; i < n ; i ++) {
+        e[i] += amount;
+      }
+
+      // spent actors which crossed above zero join the heap
+      bool refill = heap.empty();
+      unsigned int kept = 0;
+      for(auto id : spent) {
+        if(actor_slots[id] == no_index || heap_indices[id] != no_index) { continue; }
+        if(e[actor_slots[id]] <= 0) {
+          spent[kept ++] = id;
+        } else if(refill) {
+          heap_indices[id] = heap.size();
+          heap.push_back(id);
+        } else {
+          heap_insert(id);
+        }
+      }
+      spent.resize(kept);
+
+      if(refill) {
+        // actors leave the heap lowest id first, so a drained heap is usually
+        // refilled in order, and a sorted array is already a heap
+        if(!std::is_sorted(heap.begin(), heap.end())) {
+          std::sort(heap.begin(), heap.end());
+          for(uint32_t i = 0 ; i < heap.size() ; i ++) {
+            heap_indices[heap[i]] = i;
+          }
+        }
+      }
+    }
+    void TurnScheduler::use(Id id, int amount) {
+      assert(id < actor_slots.size() && actor_slots[id] != no_index);
+
+      int & e = energies[actor_slots[id]];
+      e -= amount;
+      if(e <= 0) {
+        if(heap_indices[id] != no_index) {
+          heap_remove(id);
+          spent.push_back(id);
+        }
+      } else if(heap_indices[id] == no_index) {
+        heap_insert(id);
+      }
+    }
+    int TurnScheduler::energy(Id id) const {
+      assert(id < actor_slots.size() && actor_slots[id] != no_index);
+      return energies[actor_slots[id]];
+    }
+
+    void TurnScheduler::heap_insert(Id id) {
+      heap.push_back(id);
+      heap_indices[id] = heap.size() - 1;
+      sift_up(heap.size() - 1);
+    }
+    void TurnScheduler::heap_remove(Id id) {
+      if(heap_indices[id] == no_index) { return; }
+
+      uint32_t index = heap_indices[id];
+      heap_indices[id] = no_index;
+
+      Id last = heap.back();
+      heap.pop_back();
+
+      // move the last id into the hole, and restore order whichever way
+      if(index < heap.size()) {
+        place(index, last);
+        sift_up(index);
+        sift_down(heap_indices[last]);
+      }
+    }
+
+    void TurnScheduler::place(uint32_t index, Id id) {
+      heap[index] = id;
+      heap_indices[id] = index;
+    }
+    void TurnScheduler::sift_up(uint32_t index) {
+      Id id = heap[index];
+      while(index > 0) {
+        uint32_t parent_index = (index - 1)/2;
+        if(id < heap[parent_index]) {
+          place(index, heap[parent_index]);
+          index = parent_index;
+        } else {
+          break;
+        }
+      }
+      place(index, id);
+    }
+    void TurnScheduler::sift_down(uint32_t index) {
+      Id id = heap[index];
+      while(true) {
+        uint32_t child_index = index*2 + 1;
+        if(child_index >= heap.size()) { break; }
+
+        // select the smaller child
+        if(child_index + 1 < heap.size() && heap[child_index + 1] < heap[child_index]) {
+          child_index ++;
+        }
+
+        if(heap[child_index] < id) {
+          place(index, heap[child_index]);
+          index = child_index;
+        } else {
+          break;
+        }
+      }
+      place(index, id);
+    }
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef RF_GAME_TURNSCHEDULER_HPP
+#define RF_GAME_TURNSCHEDULER_HPP
+
+#include <vector>
+#include <cstdint>
+#include <rf/game/types.hpp>
+#include <rf/game/Object.hpp>
+
+namespace rf {
+  namespace game {
+    class Level;
+
+    // Holds the turn energy of every object which acts (has_turn()), in one
+    // dense array, so that giving every actor energy is a single vectorized
+    // add. Actors which may act now -- those with positive energy -- are
+    // also kept in a heap ordered by id, so the next one to act is found
+    // without visiting the rest of the level. The rest are listed as spent,
+    // and only they are checked for readiness after a tick.
+    class TurnScheduler {
+      public:
+      // Takes every actor on `level`, with no energy.
+      void reset(const Level & level);
+      // Takes `object` if it acts, with no energy.
+      void add(const Object & object);
+      // Drops `id`, for when its object is erased.
+      void remove(Id id);
+
+      // Gives every actor `amount` energy.
+      void tick(int amount);
+      // Spends `amount` of the energy of actor `id`.
+      void use(Id id, int amount);
+      int energy(Id id) const;
+
+      // the lowest id of an actor which may act, or 0 if none may
+      Id next() const { return heap.empty() ? 0 : heap[0]; }
+      // every actor, in no particular order
+      const std::vector<Id> & actors() const { return actor_ids; }
+      unsigned int actor_count() const { return actor_ids.size(); }
+      unsigned int ready_count() const { return heap.size(); }
+
+      private:
+      static constexpr uint32_t no_index = 0xFFFFFFFF;
+
+      // one element per actor, in no particular order
+      std::vector<Id> actor_ids;
+      std::vector<int> energies;
+
+      // ids of the actors with positive energy, as a min-heap
+      std::vector<Id> heap;
+      // ids of the actors out of the heap, in the order they left it; may
+      // hold removed actors, and actors since put back, until the next tick
+      std::vector<Id> spent;
+
+      // slot in actor_ids and position in heap of each id, or no_index
+      std::vector<uint32_t> actor_slots;
+      std::vector<uint32_t> heap_indices;
+
+      void grow(Id id);
+
+      void heap_insert(Id id);
+      void heap_remove(Id id);
+      void sift_up(uint32_t index);
+      void sift_down(uint32_t index);
+      void place(uint32_t index, Id id);
+    };
+  }
+}
+
+#endif
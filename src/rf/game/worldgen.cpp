@@ -2,49 +2,50 @@
 #include "worldgen.hpp"
 
 #include <random>
+#include <algorithm>
 
 namespace rf {
   namespace game {
     namespace worldgen {
-      Tile grass_tile() {
+      Tile grass_tile(Arena & parts) {
         Color color(0x11, 0x22, 0x22);
         Tile tile;
-        tile.add(new BasicTileGlyph(
+        tile.add(parts.make<BasicTileGlyph>(
           Glyph(4 + 1*16, color, color)
         ));
         return tile;
       }
-      Tile grass_dirt_tile() {
+      Tile grass_dirt_tile(Arena & parts) {
         Color fg_color(0x88, 0x66, 0x44);
         Color bg_color(0x11, 0x22, 0x22);
         Tile tile;
-        tile.add(new BasicTileGlyph(
+        tile.add(parts.make<BasicTileGlyph>(
           Glyph(5 + 7*16, fg_color, bg_color)
         ));
         return tile;
       }
-      Tile grass_path_tile() {
+      Tile grass_path_tile(Arena & parts) {
         Color fg_color(0x88, 0x66, 0x44);
         Color bg_color(0x11, 0x22, 0x22);
         Tile tile;
-        tile.add(new BasicTileGlyph(
+        tile.add(parts.make<BasicTileGlyph>(
           Glyph(5 + 8*16, fg_color, bg_color)
         ));
         return tile;
       }
-      Tile grass_pine_needles() {
+      Tile grass_pine_needles(Arena & parts) {
         Color fg_color(0x22, 0x44, 0x44);
         Color bg_color(0x11, 0x22, 0x22);
         Tile tile;
-        tile.add(new BasicTileGlyph(
+        tile.add(parts.make<BasicTileGlyph>(
           Glyph(5 + 7*16, fg_color, bg_color)
         ));
         return tile;
       }
 
-      Object tree(unsigned int seed) {
+      Object tree(Arena & parts, unsigned int seed) {
         Object obj;
-        obj.add(new BasicObjectGlyph(
+        obj.add(parts.make<BasicObjectGlyph>(
           Glyph(
             (seed % 3) + 5 + 5*16,
             Color(0x33, 0x66, 0x33)
@@ -52,9 +53,9 @@ namespace rf {
         ));
         return obj;
       }
-      Object rock(unsigned int seed) {
+      Object rock(Arena & parts, unsigned int seed) {
         Object obj;
-        obj.add(new BasicObjectGlyph(
+        obj.add(parts.make<BasicObjectGlyph>(
           Glyph(
             (seed % 3) + 8 + 4*16,
             Color(0x88, 0x66, 0x44)
@@ -64,13 +65,24 @@ namespace rf {
       }
 
       Level troll_forest(uint64_t seed) {
-        Vec2u level_size(30, 30);
+        return troll_forest(seed, Vec2u(30, 30));
+      }
+      Level troll_forest(uint64_t seed, Vec2u level_size) {
+        // tree counts below are for a 30x30 forest
+        unsigned int area = level_size.x * level_size.y;
+        unsigned int drunkard_num = std::max(10*area/(30*30), 1u);
+        unsigned int random_tree_num = std::max(20*area/(30*30), 1u);
 
         Level lv;
         lv.tiles.resize(level_size);
 
+        TileId grass = lv.tile_types.add(grass_tile(lv.parts));
+        TileId grass_dirt = lv.tile_types.add(grass_dirt_tile(lv.parts));
+        TileId grass_path = lv.tile_types.add(grass_path_tile(lv.parts));
+        TileId pine_needles = lv.tile_types.add(grass_pine_needles(lv.parts));
+
         auto & doggo = lv.objects[lv.new_object_id()];
-        doggo.add(new BasicObjectGlyph(Glyph(3 + 1*16, Color(0xFF, 0xCC, 0x99))));
+        doggo.add(lv.parts.make<BasicObjectGlyph>(Glyph(3 + 1*16, Color(0xFF, 0xCC, 0x99))));
         doggo.set_pos(Vec2i(5, 5));
         doggo.set_has_turn(true);
         doggo.set_playable(true);
@@ -90,7 +102,7 @@ namespace rf {
         std::discrete_distribution<> dirt_path_grass({1, 1, 8});
 
         // drunken walk trees
-        for(unsigned int j = 0 ; j < 10 ; j ++) {
+        for(unsigned int j = 0 ; j < drunkard_num ; j ++) {
           Vec2i drunkard(level_x(gen), level_y(gen));
           for(unsigned int i = 0 ; i < 50 ; i ++) {
             drunkard.x += drunk_mod(gen);
@@ -106,7 +118,7 @@ namespace rf {
         }
 
         // add randomly placed trees
-        for(int i = 0 ; i < 20 ; i ++) {
+        for(unsigned int i = 0 ; i < random_tree_num ; i ++) {
           tile_ids[Vec2u(level_x(gen), level_y(gen))] = 1; // here be trees
         }
 
@@ -143,41 +155,43 @@ namespace rf {
             if(id == 0) {
               int path_type = dirt_path_grass(gen);
               if(path_type == 0) {
-                lv.tiles[Vec2u(i, j)] = grass_dirt_tile();
+                lv.tiles[Vec2u(i, j)] = grass_dirt;
               } else if(path_type == 1) {
-                lv.tiles[Vec2u(i, j)] = grass_path_tile();
+                lv.tiles[Vec2u(i, j)] = grass_path;
               } else {
-                lv.tiles[Vec2u(i, j)] = grass_tile();
+                lv.tiles[Vec2u(i, j)] = grass;
               }
             } else if(id == 1) {
               auto & tree_obj = lv.objects[lv.new_object_id()];
-              tree_obj = tree(gen());
+              tree_obj = tree(lv.parts, gen());
               tree_obj.set_pos(Vec2i(i, j));
-              lv.tiles[Vec2u(i, j)] = grass_pine_needles();
+              lv.tiles[Vec2u(i, j)] = pine_needles;
             } else {
               auto & rock_obj = lv.objects[lv.new_object_id()];
-              rock_obj = rock(gen());
+              rock_obj = rock(lv.parts, gen());
               rock_obj.set_pos(Vec2i(i, j));
-              lv.tiles[Vec2u(i, j)] = grass_path_tile();
+              lv.tiles[Vec2u(i, j)] = grass_path;
             }
           }
         }
 
         auto & orc = lv.objects[lv.new_object_id()];
-        orc.add(new BasicObjectGlyph(Glyph(0 + 1*16, Color(0xFF, 0xCC, 0x99))));
+        orc.add(lv.parts.make<BasicObjectGlyph>(Glyph(0 + 1*16, Color(0xFF, 0xCC, 0x99))));
         orc.set_pos(Vec2i(level_x(gen), level_y(gen)));
         orc.set_has_turn(true);
 
         auto & nymph = lv.objects[lv.new_object_id()];
-        nymph.add(new BasicObjectGlyph(Glyph(1 + 1*16, Color(0xFF, 0xCC, 0x99))));
+        nymph.add(lv.parts.make<BasicObjectGlyph>(Glyph(1 + 1*16, Color(0xFF, 0xCC, 0x99))));
         nymph.set_pos(Vec2i(level_x(gen), level_y(gen)));
         nymph.set_has_turn(true);
 
         auto & wizard = lv.objects[lv.new_object_id()];
-        wizard.add(new BasicObjectGlyph(Glyph(2 + 1*16, Color(0xFF, 0xCC, 0x99))));
+        wizard.add(lv.parts.make<BasicObjectGlyph>(Glyph(2 + 1*16, Color(0xFF, 0xCC, 0x99))));
         wizard.set_pos(Vec2i(level_x(gen), level_y(gen)));
         wizard.set_has_turn(true);
 
+        lv.reindex();
+
         return lv;
       }
     }
@@ -7,6 +7,8 @@ namespace rf {
   namespace game {
     namespace worldgen {
       Level troll_forest(uint64_t seed);
+      // trees are scaled with the area, so larger forests are as dense
+      Level troll_forest(uint64_t seed, Vec2u level_size);
     }
   }
 }
@@ -1,21 +1,15 @@
 
 #include "AStar.hpp"
+#include "Dijkstra.hpp"
 
 #include <cmath>
 #include <cassert>
 #include <limits>
 #include <algorithm>
+#include <random>
 
 namespace rf {
-  struct AStarNode {
-    Vec2i pos;
-    AStarNode * from = nullptr;
-    unsigned int gScore = std::numeric_limits<decltype(gScore)>::max();
-    float fScore = std::numeric_limits<decltype(fScore)>::infinity();
-    bool open = false;
-    bool closed = false;
-    unsigned int cost = 0;
-  };
+  constexpr uint32_t AStarSearch::no_index;
 
   static float manhattan_heuristic(const Vec2i & a, const Vec2i & b) {
     const float D = 1.0f;
@@ -24,234 +18,509 @@ namespace rf {
     return D * (dx + dy);
   }
   static float diagonal_heuristic(const Vec2i & a, const Vec2i & b) {
+    // diagonal steps cost the same as straight ones
     const float D = 1.0f;
-    const float D2 = sqrt(2);
     float dx = std::abs(a.x - b.x);
     float dy = std::abs(a.y - b.y);
-    return D * (dx + dy) + (D2 - 2 * D) * std::min(dx, dy);
+    return D * std::max(dx, dy);
   }
 
-  static Vec2i pos_select_8(Vec2i center, int p) {
-    assert(p >= 0);
-    assert(p < 8);
-
-    switch(p) {
-      case 0:
-        return center + Vec2i( 0,  1);
-      case 1:
-        return center + Vec2i( 1,  1);
-      case 2:
-        return center + Vec2i( 1,  0);
-      case 3:
-        return center + Vec2i( 1, -1);
-      case 4:
-        return center + Vec2i( 0, -1);
-      case 5:
-        return center + Vec2i(-1, -1);
-      case 6:
-        return center + Vec2i(-1,  0);
-      case 7:
-        return center + Vec2i(-1,  1);
-      default:
-        return center;
+  static const Vec2i offsets_8[8] = {
+    Vec2i( 0,  1),
+    Vec2i( 1,  1),
+    Vec2i( 1,  0),
+    Vec2i( 1, -1),
+    Vec2i( 0, -1),
+    Vec2i(-1, -1),
+    Vec2i(-1,  0),
+    Vec2i(-1,  1),
+  };
+  static const Vec2i offsets_4[4] = {
+    Vec2i( 0,  1),
+    Vec2i( 1,  0),
+    Vec2i( 0, -1),
+    Vec2i(-1,  0),
+  };
+
+  void AStarSearch::begin(Vec2u new_size) {
+    size = new_size;
+
+    unsigned int node_num = size.x*size.y;
+    if(nodes.size() < node_num) {
+      nodes.resize(node_num);
     }
-  }
-  static Vec2i pos_select_4(Vec2i center, int p) {
-    assert(p >= 0);
-    assert(p < 4);
-
-    switch(p) {
-      case 0:
-        return center + Vec2i( 0,  1);
-      case 1:
-        return center + Vec2i( 1,  0);
-      case 2:
-        return center + Vec2i( 0, -1);
-      case 3:
-        return center + Vec2i(-1,  0);
-      default:
-        return center;
+
+    heap.clear();
+    _expanded_count = 0;
+
+    generation ++;
+    if(generation == 0) {
+      // stamps have wrapped around, old stamps could be mistaken for new ones
+      for(auto & node : nodes) {
+        node.generation = 0;
+      }
+      generation = 1;
     }
   }
 
-  bool DoAStar4(std::vector<Vec2i> & path_out,
-                const Map<unsigned int> & cost_map,
-                Vec2i start_pos,
-                Vec2i end_pos) {
-    Map<AStarNode> nodes(cost_map.size());
-
-    for(unsigned int j = 0 ; j < nodes.size().y ; j ++) {
-      for(unsigned int i = 0 ; i < nodes.size().x ; i ++) {
-        Vec2i tile_pos = Vec2i(i, j);
-        AStarNode node;
-        node.pos = tile_pos;
-        node.from = nullptr;
-        node.gScore = std::numeric_limits<decltype(AStarNode::gScore)>::max();
-        node.fScore = std::numeric_limits<decltype(AStarNode::fScore)>::infinity();
-        node.open = false;
-        node.closed = false;
-        if(cost_map.valid(tile_pos)) {
-          node.cost = cost_map.get(tile_pos);
+  void AStarSearch::heap_push(NodeIndex node) {
+    nodes[node].heap_index = heap.size();
+    heap.push_back(node);
+    heap_decrease(node);
+  }
+  AStarSearch::NodeIndex AStarSearch::heap_pop() {
+    assert(heap.size() > 0);
+    NodeIndex top = heap[0];
+    nodes[top].heap_index = no_index;
+
+    NodeIndex node = heap.back();
+    heap.pop_back();
+
+    if(heap.size() != 0) {
+      // percolate the last element down from the top
+      float fScore = nodes[node].fScore;
+      unsigned int index = 0;
+
+      while(true) {
+        unsigned int child_a_index = index*2 + 1;
+        unsigned int child_b_index = index*2 + 2;
+
+        // select the smallest child, if any
+        unsigned int child_index;
+        if(child_a_index >= heap.size()) {
+          break;
+        } else if(child_b_index >= heap.size()) {
+          child_index = child_a_index;
+        } else if(nodes[heap[child_a_index]].fScore <
+                  nodes[heap[child_b_index]].fScore) {
+          child_index = child_a_index;
+        } else {
+          child_index = child_b_index;
+        }
+
+        NodeIndex child = heap[child_index];
+        if(nodes[child].fScore < fScore) {
+          heap[index] = child;
+          nodes[child].heap_index = index;
+          index = child_index;
         } else {
-          node.cost = std::numeric_limits<unsigned int>::max();
+          break;
         }
-        nodes.set(tile_pos, node);
       }
+
+      heap[index] = node;
+      nodes[node].heap_index = index;
     }
 
-    path_out.clear();
+    return top;
+  }
+  void AStarSearch::heap_decrease(NodeIndex node) {
+    unsigned int index = nodes[node].heap_index;
+    float fScore = nodes[node].fScore;
+
+    assert(index != no_index);
+    assert(index < heap.size());
+
+    // percolate up
+    while(index > 0) {
+      unsigned int parent_index = (index - 1)/2;
+      NodeIndex parent = heap[parent_index];
+
+      if(fScore < nodes[parent].fScore) {
+        heap[index] = parent;
+        nodes[parent].heap_index = index;
+        index = parent_index;
+      } else {
+        break;
+      }
+    }
 
-    AStarNode * end = nodes.get_ptr(end_pos);
-    AStarNode * start = nodes.get_ptr(start_pos);
+    heap[index] = node;
+    nodes[node].heap_index = index;
+  }
 
-    start->gScore = 0;
-    start->fScore = manhattan_heuristic(start_pos, end_pos);
+  template <typename Neighbors, typename Heuristic>
+  bool AStarSearch::find(std::vector<Vec2i> & path_out,
+                         const Map<unsigned int> & cost_map,
+                         Vec2i start_pos,
+                         Vec2i end_pos,
+                         const Neighbors & neighbors,
+                         unsigned int neighbor_num,
+                         Heuristic heuristic) {
+    path_out.clear();
 
-    std::vector<AStarNode *> open_set;
-    start->open = true;
-    open_set.push_back(start);
+    if(!cost_map.valid(start_pos) || !cost_map.valid(end_pos)) {
+      return false;
+    }
 
-    while(open_set.size()) {
-      float min_fScore = std::numeric_limits<float>::infinity();
-      auto min_open_it = open_set.begin();
+    begin(cost_map.size());
 
-      for(auto it = open_set.begin() ;
-          it != open_set.end() ; 
-          it ++) {
-        if((*it)->fScore < min_fScore) {
-          min_fScore = (*it)->fScore;
-          min_open_it = it;
-        }
-      }
+    NodeIndex start = cost_map.index(start_pos);
+    NodeIndex end = cost_map.index(end_pos);
 
-      auto current = *min_open_it;
+    Node & start_node = nodes[start];
+    start_node.generation = generation;
+    start_node.from = no_index;
+    start_node.gScore = 0;
+    start_node.fScore = heuristic(start_pos, end_pos);
+    heap_push(start);
+
+    while(heap.size()) {
+      NodeIndex current = heap_pop();
+      _expanded_count ++;
 
       if(current == end) {
-        auto prev = end;
-        while(prev) {
-          path_out.push_back(prev->pos);
-          prev = prev->from;
+        NodeIndex prev = end;
+        while(prev != no_index) {
+          path_out.push_back(Vec2i(prev % size.x, prev / size.x));
+          prev = nodes[prev].from;
         }
         return true;
       }
 
-      open_set.erase(min_open_it);
-      current->open = false;
-      current->closed = true;
-      // There doesn't need to be a closed_set
-      //closed_set.push_back(current);
+      Vec2i current_pos(current % size.x, current / size.x);
+      unsigned int current_gScore = nodes[current].gScore;
+
+      for(unsigned int i = 0 ; i < neighbor_num ; i ++) {
+        Vec2i neighbor_pos = current_pos + neighbors[i];
+
+        if(!cost_map.valid(neighbor_pos)) { continue; }
+
+        NodeIndex neighbor = cost_map.index(neighbor_pos);
+        Node & neighbor_node = nodes[neighbor];
+
+        // the maximum cost marks impassable cells, as does overflowing
+        unsigned int cost = cost_map[neighbor_pos];
+        if(cost == std::numeric_limits<unsigned int>::max()) { continue; }
+        unsigned int gScore_tenative = current_gScore + cost;
+        if(gScore_tenative < current_gScore) { continue; }
+
+        if(neighbor_node.generation != generation) {
+          // first visit in this search
+          neighbor_node.generation = generation;
+          neighbor_node.from = current;
+          neighbor_node.gScore = gScore_tenative;
+          neighbor_node.fScore = gScore_tenative + heuristic(neighbor_pos, end_pos);
+          heap_push(neighbor);
+        } else if(neighbor_node.heap_index != no_index &&
+                  gScore_tenative < neighbor_node.gScore) {
+          // still open, and this is a better way in
+          neighbor_node.from = current;
+          neighbor_node.gScore = gScore_tenative;
+          neighbor_node.fScore = gScore_tenative + heuristic(neighbor_pos, end_pos);
+          heap_decrease(neighbor);
+        }
+        // otherwise the neighbor is closed
+      }
+    }
+
+    return false;
+  }
+
+  static bool passable(const Map<unsigned int> & cost_map, Vec2i pos) {
+    return cost_map.valid(pos) && cost_map[pos] != std::numeric_limits<unsigned int>::max();
+  }
+  static int sign(int x) {
+    return (x > 0) - (x < 0);
+  }
+
+  bool AStarSearch::jump(Vec2i & jump_out,
+                         const Map<unsigned int> & cost_map,
+                         Vec2i pos,
+                         Vec2i dir,
+                         Vec2i end_pos) const {
+    while(true) {
+      pos += dir;
+
+      if(!passable(cost_map, pos)) { return false; }
+      if(pos == end_pos) { break; }
+
+      if(dir.x != 0 && dir.y != 0) {
+        // diagonal: stop at forced neighbors, or if a straight jump succeeds
+        if(!passable(cost_map, pos + Vec2i(-dir.x, 0)) &&
+            passable(cost_map, pos + Vec2i(-dir.x, dir.y))) { break; }
+        if(!passable(cost_map, pos + Vec2i(0, -dir.y)) &&
+            passable(cost_map, pos + Vec2i(dir.x, -dir.y))) { break; }
+
+        Vec2i unused;
+        if(jump(unused, cost_map, pos, Vec2i(dir.x, 0), end_pos)) { break; }
+        if(jump(unused, cost_map, pos, Vec2i(0, dir.y), end_pos)) { break; }
+      } else if(dir.x != 0) {
+        if(!passable(cost_map, pos + Vec2i(0,  1)) &&
+            passable(cost_map, pos + Vec2i(dir.x,  1))) { break; }
+        if(!passable(cost_map, pos + Vec2i(0, -1)) &&
+            passable(cost_map, pos + Vec2i(dir.x, -1))) { break; }
+      } else {
+        if(!passable(cost_map, pos + Vec2i( 1, 0)) &&
+            passable(cost_map, pos + Vec2i( 1, dir.y))) { break; }
+        if(!passable(cost_map, pos + Vec2i(-1, 0)) &&
+            passable(cost_map, pos + Vec2i(-1, dir.y))) { break; }
+      }
+    }
+
+    jump_out = pos;
+    return true;
+  }
+
+  bool AStarSearch::find_jps8(std::vector<Vec2i> & path_out,
+                              const Map<unsigned int> & cost_map,
+                              Vec2i start_pos,
+                              Vec2i end_pos) {
+    path_out.clear();
+
+    if(!cost_map.valid(start_pos) || !cost_map.valid(end_pos)) {
+      return false;
+    }
+
+    begin(cost_map.size());
 
-      for(int i = 0 ; i < 4 ; i ++) {
-        auto neighbor = nodes.get_ptr(pos_select_4(current->pos, i));
+    NodeIndex start = cost_map.index(start_pos);
+    NodeIndex end = cost_map.index(end_pos);
 
-        if(!neighbor) { continue; }
+    Node & start_node = nodes[start];
+    start_node.generation = generation;
+    start_node.from = no_index;
+    start_node.gScore = 0;
+    start_node.fScore = diagonal_heuristic(start_pos, end_pos);
+    heap_push(start);
 
-        if(neighbor->closed) { continue; }
+    while(heap.size()) {
+      NodeIndex current = heap_pop();
+      _expanded_count ++;
 
-        unsigned int gScore_tenative = current->gScore + neighbor->cost;
+      if(current == end) {
+        // expand the straight and diagonal segments between jump points
+        Vec2i pos = end_pos;
+        NodeIndex prev = nodes[end].from;
+        path_out.push_back(pos);
+        while(prev != no_index) {
+          Vec2i prev_pos(prev % size.x, prev / size.x);
+          Vec2i step(sign(prev_pos.x - pos.x), sign(prev_pos.y - pos.y));
+          while(pos != prev_pos) {
+            pos += step;
+            path_out.push_back(pos);
+          }
+          prev = nodes[prev].from;
+        }
+        return true;
+      }
+
+      Vec2i current_pos(current % size.x, current / size.x);
+      unsigned int current_gScore = nodes[current].gScore;
+
+      // prune the directions which have a path at least as short avoiding this node
+      Vec2i dirs[8];
+      unsigned int dir_num = 0;
 
-        if(!neighbor->open) {
-          neighbor->open = true;
-          open_set.push_back(neighbor);
-        } else if(gScore_tenative >= neighbor->gScore) {
-          continue;
+      if(nodes[current].from == no_index) {
+        for(auto & offset : offsets_8) {
+          dirs[dir_num ++] = offset;
         }
+      } else {
+        NodeIndex from = nodes[current].from;
+        Vec2i from_pos(from % size.x, from / size.x);
+        Vec2i dir(sign(current_pos.x - from_pos.x), sign(current_pos.y - from_pos.y));
+
+        if(dir.x != 0 && dir.y != 0) {
+          dirs[dir_num ++] = dir;
+          dirs[dir_num ++] = Vec2i(dir.x, 0);
+          dirs[dir_num ++] = Vec2i(0, dir.y);
+          if(!passable(cost_map, current_pos + Vec2i(-dir.x, 0))) {
+            dirs[dir_num ++] = Vec2i(-dir.x, dir.y);
+          }
+          if(!passable(cost_map, current_pos + Vec2i(0, -dir.y))) {
+            dirs[dir_num ++] = Vec2i(dir.x, -dir.y);
+          }
+        } else if(dir.x != 0) {
+          dirs[dir_num ++] = dir;
+          if(!passable(cost_map, current_pos + Vec2i(0,  1))) {
+            dirs[dir_num ++] = Vec2i(dir.x,  1);
+          }
+          if(!passable(cost_map, current_pos + Vec2i(0, -1))) {
+            dirs[dir_num ++] = Vec2i(dir.x, -1);
+          }
+        } else {
+          dirs[dir_num ++] = dir;
+          if(!passable(cost_map, current_pos + Vec2i( 1, 0))) {
+            dirs[dir_num ++] = Vec2i( 1, dir.y);
+          }
+          if(!passable(cost_map, current_pos + Vec2i(-1, 0))) {
+            dirs[dir_num ++] = Vec2i(-1, dir.y);
+          }
+        }
+      }
 
-        neighbor->from = current;
-        neighbor->gScore = gScore_tenative;
-        neighbor->fScore = gScore_tenative + manhattan_heuristic(neighbor->pos, end_pos);
+      for(unsigned int i = 0 ; i < dir_num ; i ++) {
+        Vec2i jump_pos;
+        if(!jump(jump_pos, cost_map, current_pos, dirs[i], end_pos)) { continue; }
+
+        NodeIndex neighbor = cost_map.index(jump_pos);
+        Node & neighbor_node = nodes[neighbor];
+
+        unsigned int gScore_tenative = current_gScore +
+          std::max(std::abs(jump_pos.x - current_pos.x), std::abs(jump_pos.y - current_pos.y));
+
+        if(neighbor_node.generation != generation) {
+          neighbor_node.generation = generation;
+          neighbor_node.from = current;
+          neighbor_node.gScore = gScore_tenative;
+          neighbor_node.fScore = gScore_tenative + diagonal_heuristic(jump_pos, end_pos);
+          heap_push(neighbor);
+        } else if(neighbor_node.heap_index != no_index &&
+                  gScore_tenative < neighbor_node.gScore) {
+          neighbor_node.from = current;
+          neighbor_node.gScore = gScore_tenative;
+          neighbor_node.fScore = gScore_tenative + diagonal_heuristic(jump_pos, end_pos);
+          heap_decrease(neighbor);
+        }
       }
     }
 
     return false;
   }
 
-  bool DoAStar8(std::vector<Vec2i> & path_out,
-                const Map<unsigned int> & cost_map,
-                Vec2i start_pos,
-                Vec2i end_pos) {
-    Map<AStarNode> nodes(cost_map.size());
-
-    for(unsigned int j = 0 ; j < nodes.size().y ; j ++) {
-      for(unsigned int i = 0 ; i < nodes.size().x ; i ++) {
-        Vec2i tile_pos = Vec2i(i, j);
-        AStarNode node;
-        node.pos = tile_pos;
-        node.from = nullptr;
-        node.gScore = std::numeric_limits<decltype(AStarNode::gScore)>::max();
-        node.fScore = std::numeric_limits<decltype(AStarNode::fScore)>::infinity();
-        node.open = false;
-        node.closed = false;
-        node.cost = cost_map.get(tile_pos, std::numeric_limits<unsigned int>::max());
-        nodes.set(tile_pos, node);
+  bool AStarSearch::find8(std::vector<Vec2i> & path_out,
+                          const Map<unsigned int> & cost_map,
+                          Vec2i start_pos,
+                          Vec2i end_pos) {
+    return find(path_out, cost_map, start_pos, end_pos, offsets_8, 8, diagonal_heuristic);
+  }
+  bool AStarSearch::find4(std::vector<Vec2i> & path_out,
+                          const Map<unsigned int> & cost_map,
+                          Vec2i start_pos,
+                          Vec2i end_pos) {
+    return find(path_out, cost_map, start_pos, end_pos, offsets_4, 4, manhattan_heuristic);
+  }
+
+#ifndef NDEBUG
+  static bool valid_path(const std::vector<Vec2i> & path,
+                         const Map<unsigned int> & cost_map,
+                         Vec2i start_pos,
+                         Vec2i end_pos,
+                         bool diagonals) {
+    if(path.empty()) { return false; }
+    if(path.front() != end_pos || path.back() != start_pos) { return false; }
+
+    for(unsigned int i = 0 ; i < path.size() ; i ++) {
+      if(!cost_map.valid(path[i])) { return false; }
+      if(i + 1 < path.size()) {
+        if(cost_map[path[i]] == DijkstraMap::impassable) { return false; }
+        int dx = std::abs(path[i].x - path[i + 1].x);
+        int dy = std::abs(path[i].y - path[i + 1].y);
+        if(std::max(dx, dy) != 1) { return false; }
+        if(!diagonals && dx + dy != 1) { return false; }
       }
     }
+    return true;
+  }
+#endif
 
-    path_out.clear();
-
-    AStarNode * end = nodes.get_ptr(end_pos);
-    AStarNode * start = nodes.get_ptr(start_pos);
+  void AStarSearch::test() {
+    AStarSearch search;
+    DijkstraMap dm;
 
-    start->gScore = 0;
-    start->fScore = diagonal_heuristic(start_pos, end_pos);
+    std::mt19937 gen(7);
 
-    std::vector<AStarNode *> open_set;
-    start->open = true;
-    open_set.push_back(start);
+    std::vector<Vec2i> path;
+    std::vector<Vec2i> fresh_path;
 
-    while(open_set.size()) {
-      float min_fScore = std::numeric_limits<float>::infinity();
-      auto min_open_it = open_set.begin();
+    for(int i = 0 ; i < 60 ; i ++) {
+      // alternate between large and small maps, so that node storage is reused
+      Vec2u size = (i % 2) ? Vec2u(1 + gen() % 8, 1 + gen() % 8) :
+                             Vec2u(8 + gen() % 32, 8 + gen() % 32);
 
-      for(auto it = open_set.begin() ;
-          it != open_set.end() ; 
-          it ++) {
-        if((*it)->fScore < min_fScore) {
-          min_fScore = (*it)->fScore;
-          min_open_it = it;
+      Map<unsigned int> costs(size);
+      for(unsigned int y = 0 ; y < size.y ; y ++) {
+        for(unsigned int x = 0 ; x < size.x ; x ++) {
+          costs[Vec2u(x, y)] = (gen() % 4 == 0) ? DijkstraMap::impassable : 1 + gen() % 3;
         }
       }
 
-      auto current = *min_open_it;
+      Vec2i start(gen() % size.x, gen() % size.y);
+      Vec2i end(gen() % size.x, gen() % size.y);
 
-      if(current == end) {
-        auto prev = end;
-        while(prev) {
-          path_out.push_back(prev->pos);
-          prev = prev->from;
-        }
-        return true;
-      }
+      // A* must agree with a full search about reachability
+      auto distances = dm.compute(costs, Vec2u(start));
+      bool reachable = distances[end] != DijkstraMap::infinity;
+      (void)reachable;
 
-      open_set.erase(min_open_it);
-      current->open = false;
-      current->closed = true;
-      // There doesn't need to be a closed_set
-      //closed_set.push_back(current);
+      bool found = search.find8(path, costs, start, end);
+      assert(found == reachable);
+      assert(!found || valid_path(path, costs, start, end, true));
 
-      for(int i = 0 ; i < 8 ; i ++) {
-        auto neighbor = nodes.get_ptr(pos_select_8(current->pos, i));
+      // and its paths must be as cheap as possible
+      if(found) {
+        int path_cost = 0;
+        for(unsigned int j = 0 ; j + 1 < path.size() ; j ++) {
+          path_cost += costs[path[j]];
+        }
+        assert(path_cost == distances[end]);
+      }
 
-        if(!neighbor) { continue; }
+      // a fresh search object must produce the same path
+      AStarSearch fresh;
+      assert(fresh.find8(fresh_path, costs, start, end) == found);
+      assert(fresh_path == path);
 
-        if(neighbor->closed) { continue; }
+      if(search.find4(path, costs, start, end)) {
+        assert(valid_path(path, costs, start, end, false));
+      } else {
+        assert(path.empty());
+      }
+    }
 
-        unsigned int gScore_tenative = current->gScore + neighbor->cost;
+    // jump point search must find paths as short as A* on uniform maps
+    for(int i = 0 ; i < 200 ; i ++) {
+      Vec2u size(1 + gen() % 40, 1 + gen() % 40);
+      unsigned int wall_chance = gen() % 6;
 
-        if(!neighbor->open) {
-          neighbor->open = true;
-          open_set.push_back(neighbor);
-        } else if(gScore_tenative >= neighbor->gScore) {
-          continue;
+      Map<unsigned int> costs(size);
+      for(unsigned int y = 0 ; y < size.y ; y ++) {
+        for(unsigned int x = 0 ; x < size.x ; x ++) {
+          costs[Vec2u(x, y)] = (gen() % 10 < wall_chance) ? DijkstraMap::impassable : 1;
         }
-
-        neighbor->from = current;
-        neighbor->gScore = gScore_tenative;
-        neighbor->fScore = gScore_tenative + diagonal_heuristic(neighbor->pos, end_pos);
       }
+
+      Vec2i start(gen() % size.x, gen() % size.y);
+      Vec2i end(gen() % size.x, gen() % size.y);
+
+      bool found = search.find8(path, costs, start, end);
+      (void)found;
+      assert(search.find_jps8(fresh_path, costs, start, end) == found);
+      assert(fresh_path.size() == path.size());
+      assert(!found || valid_path(fresh_path, costs, start, end, true));
     }
 
-    return false;
+    // out of bounds endpoints are unreachable
+    Map<unsigned int> costs(Vec2u(4, 4));
+    costs.fill(1);
+    assert(!search.find8(path, costs, Vec2i(-1, 0), Vec2i(2, 2)));
+    assert(!search.find4(path, costs, Vec2i(0, 0), Vec2i(4, 2)));
+    assert(search.find4(path, costs, Vec2i(1, 1), Vec2i(1, 1)));
+    assert(path.size() == 1);
   }
-}
 
+  bool DoJPS8(std::vector<Vec2i> & path_out,
+              const Map<unsigned int> & cost_map,
+              Vec2i start_pos,
+              Vec2i end_pos) {
+    static thread_local AStarSearch search;
+    return search.find_jps8(path_out, cost_map, start_pos, end_pos);
+  }
+
+  bool DoAStar4(std::vector<Vec2i> & path_out,
+                const Map<unsigned int> & cost_map,
+                Vec2i start_pos,
+                Vec2i end_pos) {
+    static thread_local AStarSearch search;
+    return search.find4(path_out, cost_map, start_pos, end_pos);
+  }
+
+  bool DoAStar8(std::vector<Vec2i> & path_out,
+                const Map<unsigned int> & cost_map,
+                Vec2i start_pos,
+                Vec2i end_pos) {
+    static thread_local AStarSearch search;
+    return search.find8(path_out, cost_map, start_pos, end_pos);
+  }
+}
@@ -1,17 +1,98 @@
 #ifndef RF_GAME_ASTAR_HPP
 #define RF_GAME_ASTAR_HPP
 
+#include <cstdint>
 #include <vector>
 
 #include <rf/util/Vec2.hpp>
 #include <rf/util/Map.hpp>
 
 namespace rf {
+  // A* search state which is kept between searches. Node storage is only
+  // reallocated when the cost map grows, and is invalidated in O(1) by
+  // advancing a generation stamp. The open set is an indexed binary heap.
+  class AStarSearch {
+    public:
+    AStarSearch() = default;
+    AStarSearch(const AStarSearch & other) = delete;
+    AStarSearch & operator=(const AStarSearch & other) = delete;
+
+    // Writes the path from `end_pos` back to `start_pos` (both inclusive)
+    // into `path_out`, and returns true, if there is one.
+    bool find8(std::vector<Vec2i> & path_out,
+               const Map<unsigned int> & cost_map,
+               Vec2i start_pos,
+               Vec2i end_pos);
+    bool find4(std::vector<Vec2i> & path_out,
+               const Map<unsigned int> & cost_map,
+               Vec2i start_pos,
+               Vec2i end_pos);
+    // Jump point search over the same moves as find8(). Every cell which is
+    // not impassable is treated as having the same cost, and paths have the
+    // same length as those found by find8() on such maps.
+    bool find_jps8(std::vector<Vec2i> & path_out,
+                   const Map<unsigned int> & cost_map,
+                   Vec2i start_pos,
+                   Vec2i end_pos);
+
+    // number of nodes closed by the last search
+    unsigned int expanded_count() const { return _expanded_count; }
+
+    static void test();
+
+    private:
+    typedef uint32_t NodeIndex;
+    static constexpr uint32_t no_index = 0xFFFFFFFF;
+
+    struct Node {
+      // the node is unvisited unless this matches the search's generation
+      uint32_t generation = 0;
+      NodeIndex from = no_index;
+      unsigned int gScore = 0;
+      float fScore = 0.0f;
+      // location in the heap, or no_index once closed
+      uint32_t heap_index = no_index;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<NodeIndex> heap;
+    uint32_t generation = 0;
+    Vec2u size;
+
+    unsigned int _expanded_count = 0;
+
+    void begin(Vec2u size);
+
+    template <typename Neighbors, typename Heuristic>
+    bool find(std::vector<Vec2i> & path_out,
+              const Map<unsigned int> & cost_map,
+              Vec2i start_pos,
+              Vec2i end_pos,
+              const Neighbors & neighbors,
+              unsigned int neighbor_num,
+              Heuristic heuristic);
+
+    bool jump(Vec2i & jump_out,
+              const Map<unsigned int> & cost_map,
+              Vec2i pos,
+              Vec2i dir,
+              Vec2i end_pos) const;
+
+    void heap_push(NodeIndex node);
+    NodeIndex heap_pop();
+    void heap_decrease(NodeIndex node);
+  };
+
   bool DoAStar8(std::vector<Vec2i> & path_out,
                 const Map<unsigned int> & cost_map,
                 Vec2i start_pos,
                 Vec2i end_pos);
 
+  bool DoJPS8(std::vector<Vec2i> & path_out,
+              const Map<unsigned int> & cost_map,
+              Vec2i start_pos,
+              Vec2i end_pos);
+
   bool DoAStar4(std::vector<Vec2i> & path_out,
                 const Map<unsigned int> & cost_map,
                 Vec2i start_pos,
@@ -0,0 +1,177 @@
+
+#include "Arena.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <random>
+
+namespace rf {
+  Arena::Arena(size_t block_size)
+    : block_size(block_size) {
+    assert(block_size > 0);
+  }
+  Arena::Arena(Arena && other) noexcept
+    : block_size(other.block_size),
+      blocks(std::move(other.blocks)),
+      cursor(other.cursor),
+      end(other.end),
+      _used(other._used),
+      destructors(std::move(other.destructors)) {
+    other.blocks.clear();
+    other.destructors.clear();
+    other.cursor = nullptr;
+    other.end = nullptr;
+    other._used = 0;
+  }
+  Arena & Arena::operator=(Arena && other) noexcept {
+    if(this != &other) {
+      clear();
+      block_size = other.block_size;
+      blocks = std::move(other.blocks);
+      cursor = other.cursor;
+      end = other.end;
+      _used = other._used;
+      destructors = std::move(other.destructors);
+
+      other.blocks.clear();
+      other.destructors.clear();
+      other.cursor = nullptr;
+      other.end = nullptr;
+      other._used = 0;
+    }
+    return *this;
+  }
+  Arena::~Arena() {
+    clear();
+  }
+
+  void * Arena::allocate(size_t size, size_t align) {
+    // blocks come from operator new[], which aligns this much at most
+    assert(align > 0 && (align & (align - 1)) == 0);
+    assert(align <= alignof(std::max_align_t));
+
+    uintptr_t p = ((uintptr_t)cursor + align - 1) & ~(uintptr_t)(align - 1);
+    if(cursor == nullptr || p + size > (uintptr_t)end) {
+      // anything bigger than a quarter block gets a block of its own, so
+      // the rest of the current block is not wasted
+      if(size > block_size/4) {
+        blocks.emplace_back(new char[size]);
+        _used += size;
+        return blocks.back().get();
+      }
+
+      blocks.emplace_back(new char[block_size]);
+      cursor = blocks.back().get();
+      end = cursor + block_size;
+      p = (uintptr_t)cursor;
+    }
+
+    cursor = (char *)(p + size);
+    _used += size;
+    return (void *)p;
+  }
+
+  void Arena::clear() {
+    for(auto it = destructors.rbegin() ; it != destructors.rend() ; it ++) {
+      it->destroy(it->object);
+    }
+    destructors.clear();
+    blocks.clear();
+    cursor = nullptr;
+    end = nullptr;
+    _used = 0;
+  }
+
+  namespace {
+    // records the order in which instances are destroyed
+    struct Tracked {
+      static std::vector<int> destroyed;
+      int value;
+      Tracked(int value) : value(value) {}
+      ~Tracked() { destroyed.push_back(value); }
+    };
+    std::vector<int> Tracked::destroyed;
+
+    struct alignas(16) Wide {
+      char bytes[48];
+    };
+  }
+
+  void Arena::test() {
+    std::mt19937 gen(5);
+
+    for(int i = 0 ; i < 10 ; i ++) {
+      Arena arena(64 + gen() % 512);
+      Tracked::destroyed.clear();
+
+      // mixed sizes and alignments, each filled with its own byte
+      struct Allocation {
+        char * p;
+        size_t size;
+        char fill;
+      };
+      std::vector<Allocation> allocations;
+      int tracked_num = 0;
+
+      for(int j = 0 ; j < 500 ; j ++) {
+        switch(gen() % 4) {
+          case 0: {
+            size_t size = 1 + gen() % 300;
+            size_t align = 1 << (gen() % 4);
+            char * p = (char *)arena.allocate(size, align);
+            assert((uintptr_t)p % align == 0);
+            char fill = gen();
+            memset(p, fill, size);
+            allocations.push_back({ p, size, fill });
+            break;
+          }
+          case 1: {
+            Wide * w = arena.make<Wide>();
+            assert((uintptr_t)w % 16 == 0);
+            char fill = gen();
+            memset(w->bytes, fill, sizeof(w->bytes));
+            allocations.push_back({ w->bytes, sizeof(w->bytes), fill });
+            break;
+          }
+          default: {
+            Tracked * t = arena.make<Tracked>(tracked_num);
+            (void)t;
+            assert(t->value == tracked_num);
+            tracked_num ++;
+
+            // small objects made one after another are adjacent, unless
+            // the block ran out
+            unsigned int block_count = arena.block_count();
+            Tracked * u = arena.make<Tracked>(tracked_num);
+            (void)block_count;
+            (void)u;
+            tracked_num ++;
+            assert(u == t + 1 || arena.block_count() > block_count);
+            break;
+          }
+        }
+      }
+
+      // nothing was overwritten by a later allocation
+      for(auto & a : allocations) {
+        for(size_t k = 0 ; k < a.size ; k ++) {
+          assert(a.p[k] == a.fill);
+        }
+      }
+
+      // moving hands every object over, and leaves an empty arena
+      Arena moved(std::move(arena));
+      assert(arena.block_count() == 0 && arena.used() == 0);
+      arena.clear();
+      assert(Tracked::destroyed.empty());
+
+      moved.clear();
+      assert((int)Tracked::destroyed.size() == tracked_num);
+      for(int k = 0 ; k < tracked_num ; k ++) {
+        assert(Tracked::destroyed[k] == tracked_num - 1 - k);
+      }
+      assert(moved.block_count() == 0 && moved.used() == 0);
+    }
+  }
+}
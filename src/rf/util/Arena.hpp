@@ -0,0 +1,68 @@
+#ifndef RF_UTIL_ARENA_HPP
+#define RF_UTIL_ARENA_HPP
+
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <type_traits>
+
+namespace rf {
+  // Hands out memory from large blocks, for objects which all live until the
+  // arena is cleared or destroyed. Objects are never freed one at a time, so
+  // consecutive allocations sit next to each other, and releasing everything
+  // costs a destructor call per object and a free per block.
+  class Arena {
+    public:
+    Arena(size_t block_size = 16*1024);
+    Arena(const Arena & other) = delete;
+    Arena & operator=(const Arena & other) = delete;
+    Arena(Arena && other) noexcept;
+    Arena & operator=(Arena && other) noexcept;
+    ~Arena();
+
+    // Constructs a T in the arena. It is destroyed when the arena is
+    // cleared, in the reverse order of construction.
+    template <typename T, typename... Args>
+    T * make(Args &&... args) {
+      T * object = new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+      if(!std::is_trivially_destructible<T>::value) {
+        destructors.push_back({ object, &destroy<T> });
+      }
+      return object;
+    }
+
+    // uninitialized memory, valid until the arena is cleared
+    void * allocate(size_t size, size_t align);
+
+    // Destroys every object and releases every block.
+    void clear();
+
+    unsigned int block_count() const { return blocks.size(); }
+    // bytes handed out since the arena was last cleared
+    size_t used() const { return _used; }
+
+    static void test();
+
+    private:
+    struct Destructor {
+      void * object;
+      void (*destroy)(void * object);
+    };
+
+    template <typename T>
+    static void destroy(void * object) {
+      static_cast<T *>(object)->~T();
+    }
+
+    size_t block_size;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char * cursor = nullptr;
+    char * end = nullptr;
+    size_t _used = 0;
+
+    std::vector<Destructor> destructors;
+  };
+}
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef RF_UTIL_BITGRID_HPP
+#define RF_UTIL_BITGRID_HPP
+
+#include "Vec2.hpp"
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <algorithm>
+
+namespace rf {
+  // A grid of bits, 64 cells to a word. Each row starts on a new word, and
+  // bits past the end of a row are always zero.
+  class BitGrid {
+    public:
+    typedef uint64_t Word;
+    static constexpr unsigned int word_bits = 64;
+
+    BitGrid() noexcept {}
+    BitGrid(Vec2u size) {
+      resize(size);
+    }
+
+    // resizes and clears every bit
+    void resize(Vec2u size) {
+      _size = size;
+      _row_words = (size.x + word_bits - 1) / word_bits;
+      _words.assign(_row_words * size.y, 0);
+    }
+
+    void clear() noexcept {
+      std::fill(_words.begin(), _words.end(), 0);
+    }
+    void fill(bool b) noexcept {
+      if(!b || _row_words == 0) {
+        clear();
+        return;
+      }
+      for(unsigned int y = 0 ; y < _size.y ; y ++) {
+        Word * r = row(y);
+        for(unsigned int k = 0 ; k < _row_words ; k ++) {
+          r[k] = ~Word(0);
+        }
+        r[_row_words - 1] &= tail_mask();
+      }
+    }
+
+    bool valid(Vec2i pos) const noexcept {
+      if(pos.x < 0 || (unsigned int)pos.x >= _size.x) { return false; }
+      if(pos.y < 0 || (unsigned int)pos.y >= _size.y) { return false; }
+      return true;
+    }
+
+    bool get(Vec2u pos) const noexcept {
+      return (_words[pos.y*_row_words + pos.x/word_bits] >> (pos.x % word_bits)) & 1;
+    }
+    void set(Vec2u pos) noexcept {
+      _words[pos.y*_row_words + pos.x/word_bits] |= Word(1) << (pos.x % word_bits);
+    }
+    void reset(Vec2u pos) noexcept {
+      _words[pos.y*_row_words + pos.x/word_bits] &= ~(Word(1) << (pos.x % word_bits));
+    }
+
+    Vec2u size() const noexcept { return _size; }
+    unsigned int row_words() const noexcept { return _row_words; }
+    Word * row(unsigned int y) noexcept { return _words.data() + y*_row_words; }
+    const Word * row(unsigned int y) const noexcept { return _words.data() + y*_row_words; }
+
+    // number of set bits
+    size_t count() const noexcept {
+      size_t n = 0;
+      for(auto w : _words) {
+        n += __builtin_popcountll(w);
+      }
+      return n;
+    }
+
+    // Copies the bits in `rect` into `out`, which is resized to rect.size.
+    // The rect may lie partly or wholly outside this grid; bits outside read
+    // as zero. Whole words are shifted into place, 64 cells at a time.
+    void copy_rect(BitGrid & out, const Rect2i & rect) const {
+      out.resize(Vec2u(rect.size));
+      if(out._row_words == 0) { return; }
+
+      for(unsigned int y = 0 ; y < out._size.y ; y ++) {
+        int src_y = rect.pos.y + (int)y;
+        if(src_y < 0 || src_y >= (int)_size.y) { continue; }
+
+        const Word * src = row(src_y);
+        Word * dst = out.row(y);
+
+        for(unsigned int k = 0 ; k < out._row_words ; k ++) {
+          dst[k] = extract(src, rect.pos.x + (int)(k*word_bits));
+        }
+        dst[out._row_words - 1] &= out.tail_mask();
+      }
+    }
+
+    // Calls fn(pos) for every set bit inside `rect`, row by row, skipping
+    // clear bits a word at a time.
+    template<typename Fn>
+    void for_each_set(const Rect2i & rect, Fn fn) const {
+      int x0 = std::max(rect.pos.x, 0);
+      int y0 = std::max(rect.pos.y, 0);
+      int x1 = std::min(rect.pos.x + rect.size.x, (int)_size.x);
+      int y1 = std::min(rect.pos.y + rect.size.y, (int)_size.y);
+      if(x0 >= x1 || y0 >= y1) { return; }
+
+      unsigned int k0 = x0 / word_bits;
+      unsigned int k1 = (x1 - 1) / word_bits;
+      Word first_mask = ~Word(0) << (x0 % word_bits);
+      Word last_mask = ~Word(0) >> (word_bits - 1 - (x1 - 1) % word_bits);
+
+      for(int y = y0 ; y < y1 ; y ++) {
+        const Word * r = row(y);
+        for(unsigned int k = k0 ; k <= k1 ; k ++) {
+          Word w = r[k];
+          if(k == k0) { w &= first_mask; }
+          if(k == k1) { w &= last_mask; }
+          while(w) {
+            fn(Vec2i(k*word_bits + __builtin_ctzll(w), y));
+            w &= w - 1;
+          }
+        }
+      }
+    }
+
+    private:
+    std::vector<Word> _words;
+    Vec2u _size;
+    unsigned int _row_words = 0;
+
+    // mask of the bits in use in the last word of each row
+    Word tail_mask() const noexcept {
+      unsigned int tail = _size.x % word_bits;
+      return tail ? (Word(1) << tail) - 1 : ~Word(0);
+    }
+
+    Word word_at(const Word * src, int k) const noexcept {
+      if(k < 0 || k >= (int)_row_words) { return 0; }
+      return src[k];
+    }
+
+    // the 64 bits of a row starting at bit `offset`, which may be negative
+    Word extract(const Word * src, int offset) const noexcept {
+      int k = offset >= 0 ? offset / (int)word_bits : -((-offset + (int)word_bits - 1) / (int)word_bits);
+      unsigned int shift = offset - k*(int)word_bits;
+
+      Word lo = word_at(src, k);
+      if(shift == 0) { return lo; }
+      Word hi = word_at(src, k + 1);
+      return (lo >> shift) | (hi << (word_bits - shift));
+    }
+  };
+}
+
+#endif
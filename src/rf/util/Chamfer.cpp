@@ -0,0 +1,348 @@
+
+#include "Chamfer.hpp"
+
+#include <cassert>
+#include <algorithm>
+#include <random>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace rf {
+  constexpr ChamferMap::Distance ChamferMap::infinity;
+
+  bool ChamferMap::is_uniform(const Map<unsigned int> & costs, unsigned int & cost) {
+    const unsigned int * data = costs.data();
+    const unsigned int * end = data + costs.size().x * costs.size().y;
+
+    unsigned int first_cost = DijkstraMap::impassable;
+    for( ; data != end ; data ++) {
+      if(*data != DijkstraMap::impassable) {
+        if(first_cost == DijkstraMap::impassable) {
+          first_cost = *data;
+        } else if(*data != first_cost) {
+          return false;
+        }
+      }
+    }
+
+    if(first_cost == DijkstraMap::impassable) {
+      // nothing can be entered, so any cost will do
+      cost = 1;
+      return true;
+    } else if(first_cost <= (unsigned int)infinity) {
+      cost = first_cost;
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  void ChamferMap::compute(Map<Distance> & distances,
+                           const Map<unsigned int> & costs,
+                           Vec2u start) {
+    assert(costs.valid(start));
+    init(costs);
+    seed(start, 0);
+    do_sweeps(distances);
+  }
+  void ChamferMap::compute(Map<Distance> & distances,
+                           const Map<unsigned int> & costs,
+                           const std::vector<Vec2u> & start) {
+#ifndef NDEBUG
+    for(auto & p : start) {
+      assert(costs.valid(p));
+    }
+#endif
+    init(costs);
+    for(auto & p : start) {
+      seed(p, 0);
+    }
+    do_sweeps(distances);
+  }
+  void ChamferMap::compute(Map<Distance> & distances,
+                           const Map<unsigned int> & costs,
+                           const std::vector<Goal> & start) {
+#ifndef NDEBUG
+    for(auto & p : start) {
+      assert(costs.valid(p.first));
+    }
+#endif
+    init(costs);
+    for(auto & p : start) {
+      seed(p.first, p.second);
+    }
+    do_sweeps(distances);
+  }
+
+  void ChamferMap::test() {
+    ChamferMap cm;
+    DijkstraMap dm;
+
+    std::mt19937 gen(4);
+
+    for(int i = 0 ; i < 40 ; i ++) {
+      Vec2u size(1 + gen() % 40, 1 + gen() % 40);
+      unsigned int cost = (i % 2) ? 1 : 1 + gen() % 4;
+
+      Map<unsigned int> costs(size);
+      for(unsigned int y = 0 ; y < size.y ; y ++) {
+        for(unsigned int x = 0 ; x < size.x ; x ++) {
+          bool wall = (gen() % 4 == 0);
+          // every fourth map is a serpentine maze, which needs many sweeps
+          if(i % 4 == 3) {
+            wall = (y % 2 == 1) && (x != ((y / 2) % 2 ? 0 : size.x - 1));
+          }
+          costs[Vec2u(x, y)] = wall ? DijkstraMap::impassable : cost;
+        }
+      }
+
+      unsigned int uniform_cost = 0;
+      bool uniform = is_uniform(costs, uniform_cost);
+      (void)uniform;
+      assert(uniform);
+      assert(uniform_cost == cost);
+
+      std::vector<Goal> goals;
+      for(unsigned int j = 0 ; j <= gen() % 3 ; j ++) {
+        Vec2u p(gen() % size.x, gen() % size.y);
+        goals.push_back(std::make_pair(p, (int)(gen() % 10) - 5));
+      }
+
+      Map<Distance> chamfer_map;
+      cm.compute(chamfer_map, costs, goals);
+      auto expected = dm.compute(costs, goals);
+
+      for(unsigned int y = 0 ; y < size.y ; y ++) {
+        for(unsigned int x = 0 ; x < size.x ; x ++) {
+          assert(chamfer_map[Vec2u(x, y)] == expected[Vec2u(x, y)]);
+        }
+      }
+    }
+
+    Map<unsigned int> mixed_costs(Vec2u(3, 3));
+    mixed_costs.fill(1);
+    mixed_costs[Vec2u(1, 1)] = 2;
+    unsigned int mixed_cost = 0;
+    bool mixed_uniform = is_uniform(mixed_costs, mixed_cost);
+    (void)mixed_uniform;
+    assert(!mixed_uniform);
+  }
+
+  void ChamferMap::init(const Map<unsigned int> & costs) {
+    Vec2u size = costs.size();
+
+    assert(size.x != 0);
+    assert(size.y != 0);
+
+    unsigned int cost = 0;
+    bool uniform = is_uniform(costs, cost);
+    assert(uniform);
+    (void)uniform;
+
+    grid_size = size;
+    grid_stride = size.x + 2;
+    cell_cost = cost;
+
+    unsigned int cell_num = (size.x + 2) * (size.y + 2);
+
+    // only reallocates if we need more space
+    grid_distances.resize(cell_num);
+    grid_masks.resize(cell_num);
+
+    std::fill(grid_distances.begin(), grid_distances.end(), infinity);
+    std::fill(grid_masks.begin(), grid_masks.end(), 0);
+
+    for(unsigned int y = 0 ; y < size.y ; y ++) {
+      int32_t * mask_row = grid_masks.data() + grid_index(Vec2u(0, y));
+      const unsigned int * cost_row = costs.data() + y*size.x;
+
+      for(unsigned int x = 0 ; x < size.x ; x ++) {
+        mask_row[x] = (cost_row[x] == DijkstraMap::impassable) ? 0 : -1;
+      }
+    }
+  }
+  void ChamferMap::seed(Vec2u pos, Distance distance) {
+    Distance & d = grid_distances[grid_index(pos)];
+    if(distance < d) {
+      d = distance;
+    }
+  }
+
+  void ChamferMap::do_sweeps(Map<Distance> & distances) {
+    unsigned int height = grid_size.y;
+
+    // rows are indexed from 1, with the border rows 0 and height + 1 never
+    // changing
+    row_changed.assign(height + 2, 0);
+    row_forward.assign(height + 2, 0);
+    row_backward.assign(height + 2, 0);
+    for(unsigned int y = 1 ; y <= height ; y ++) {
+      row_changed[y] = 1;
+    }
+
+    unsigned int step = 1;
+
+    _sweep_count = 0;
+
+    bool changed = true;
+    while(changed) {
+      changed = false;
+
+      // forward: from the row above, then from the left
+      for(unsigned int y = 1 ; y <= height ; y ++) {
+        if(row_changed[y - 1] > row_forward[y] || row_changed[y] > row_forward[y]) {
+          unsigned int row = y*grid_stride + 1;
+          step ++;
+          bool row_changed_now = sweep_row(row, row - grid_stride);
+          row_changed_now |= scan_row_forward(row);
+          if(row_changed_now) {
+            row_changed[y] = step;
+            changed = true;
+          }
+          row_forward[y] = step;
+        }
+      }
+
+      // backward: from the row below, then from the right
+      for(unsigned int y = height ; y >= 1 ; y --) {
+        if(row_changed[y + 1] > row_backward[y] || row_changed[y] > row_backward[y]) {
+          unsigned int row = y*grid_stride + 1;
+          step ++;
+          bool row_changed_now = sweep_row(row, row + grid_stride);
+          row_changed_now |= scan_row_backward(row);
+          if(row_changed_now) {
+            row_changed[y] = step;
+            changed = true;
+          }
+          row_backward[y] = step;
+        }
+      }
+
+      _sweep_count ++;
+    }
+
+    distances.resize(grid_size);
+
+    for(unsigned int y = 0 ; y < grid_size.y ; y ++) {
+      auto row = grid_distances.begin() + grid_index(Vec2u(0, y));
+      std::copy(row, row + grid_size.x, distances.data() + y*grid_size.x);
+    }
+  }
+
+  // Lowers every passable cell of a row to one more step than the nearest of
+  // the three cells adjacent to it in the reference row. Cells in a row do
+  // not depend on each other here, so this is done several at a time.
+  bool ChamferMap::sweep_row(unsigned int row_idx, unsigned int ref_idx) {
+    Distance * row = grid_distances.data() + row_idx;
+    const Distance * ref = grid_distances.data() + ref_idx;
+    const int32_t * mask = grid_masks.data() + row_idx;
+
+    // adding cell_cost to anything above this would overflow
+    const Distance limit = infinity - cell_cost;
+    const unsigned int width = grid_size.x;
+
+    unsigned int x = 0;
+    bool changed = false;
+
+#if defined(__AVX2__)
+    const __m256i v_limit = _mm256_set1_epi32(limit);
+    const __m256i v_cost = _mm256_set1_epi32(cell_cost);
+    const __m256i v_infinity = _mm256_set1_epi32(infinity);
+    __m256i v_changed = _mm256_setzero_si256();
+
+    for( ; x + 8 <= width ; x += 8) {
+      __m256i a = _mm256_loadu_si256((const __m256i *)(ref + x - 1));
+      __m256i b = _mm256_loadu_si256((const __m256i *)(ref + x));
+      __m256i c = _mm256_loadu_si256((const __m256i *)(ref + x + 1));
+      __m256i m = _mm256_min_epi32(_mm256_min_epi32(a, b), c);
+      m = _mm256_add_epi32(_mm256_min_epi32(m, v_limit), v_cost);
+
+      __m256i v_mask = _mm256_loadu_si256((const __m256i *)(mask + x));
+      m = _mm256_blendv_epi8(v_infinity, m, v_mask);
+
+      __m256i d = _mm256_loadu_si256((const __m256i *)(row + x));
+      v_changed = _mm256_or_si256(v_changed, _mm256_cmpgt_epi32(d, m));
+      _mm256_storeu_si256((__m256i *)(row + x), _mm256_min_epi32(d, m));
+    }
+
+    changed = !_mm256_testz_si256(v_changed, v_changed);
+#elif defined(__SSE2__)
+    // SSE2 has no 32-bit min, so select through a comparison mask
+    auto min_epi32 = [](__m128i a, __m128i b) {
+      __m128i a_less = _mm_cmplt_epi32(a, b);
+      return _mm_or_si128(_mm_and_si128(a_less, a), _mm_andnot_si128(a_less, b));
+    };
+
+    const __m128i v_limit = _mm_set1_epi32(limit);
+    const __m128i v_cost = _mm_set1_epi32(cell_cost);
+    const __m128i v_infinity = _mm_set1_epi32(infinity);
+    __m128i v_changed = _mm_setzero_si128();
+
+    for( ; x + 4 <= width ; x += 4) {
+      __m128i a = _mm_loadu_si128((const __m128i *)(ref + x - 1));
+      __m128i b = _mm_loadu_si128((const __m128i *)(ref + x));
+      __m128i c = _mm_loadu_si128((const __m128i *)(ref + x + 1));
+      __m128i m = min_epi32(min_epi32(a, b), c);
+      m = _mm_add_epi32(min_epi32(m, v_limit), v_cost);
+
+      __m128i v_mask = _mm_loadu_si128((const __m128i *)(mask + x));
+      m = _mm_or_si128(_mm_and_si128(v_mask, m), _mm_andnot_si128(v_mask, v_infinity));
+
+      __m128i d = _mm_loadu_si128((const __m128i *)(row + x));
+      __m128i m_less = _mm_cmplt_epi32(m, d);
+      v_changed = _mm_or_si128(v_changed, m_less);
+      _mm_storeu_si128((__m128i *)(row + x),
+                       _mm_or_si128(_mm_and_si128(m_less, m), _mm_andnot_si128(m_less, d)));
+    }
+
+    changed = _mm_movemask_epi8(v_changed) != 0;
+#endif
+
+    // remaining cells, or all of them without SIMD
+    for( ; x < width ; x ++) {
+      const Distance * r = ref + x;
+      Distance m = std::min(std::min(r[-1], r[0]), r[1]);
+      m = std::min(m, limit) + cell_cost;
+      if(mask[x] && m < row[x]) {
+        row[x] = m;
+        changed = true;
+      }
+    }
+
+    return changed;
+  }
+  bool ChamferMap::scan_row_forward(unsigned int row_idx) {
+    Distance * row = grid_distances.data() + row_idx;
+    const int32_t * mask = grid_masks.data() + row_idx;
+    const Distance limit = infinity - cell_cost;
+
+    bool changed = false;
+    for(int x = 0 ; x < (int)grid_size.x ; x ++) {
+      Distance m = std::min(row[x - 1], limit) + cell_cost;
+      if(mask[x] && m < row[x]) {
+        row[x] = m;
+        changed = true;
+      }
+    }
+    return changed;
+  }
+  bool ChamferMap::scan_row_backward(unsigned int row_idx) {
+    Distance * row = grid_distances.data() + row_idx;
+    const int32_t * mask = grid_masks.data() + row_idx;
+    const Distance limit = infinity - cell_cost;
+
+    bool changed = false;
+    for(int x = grid_size.x - 1 ; x >= 0 ; x --) {
+      Distance m = std::min(row[x + 1], limit) + cell_cost;
+      if(mask[x] && m < row[x]) {
+        row[x] = m;
+        changed = true;
+      }
+    }
+    return changed;
+  }
+}
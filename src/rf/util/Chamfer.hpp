@@ -0,0 +1,85 @@
+#ifndef RF_UTIL_CHAMFER_HPP
+#define RF_UTIL_CHAMFER_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <rf/util/Vec2.hpp>
+#include <rf/util/Map.hpp>
+#include <rf/util/Dijkstra.hpp>
+
+namespace rf {
+  // Distance transform for cost maps in which every cell has the same cost,
+  // or is impassable. Produces exactly the distances DijkstraMap::compute
+  // would, but by repeating a forward and a backward raster sweep until
+  // nothing changes, rather than through a priority queue. Open maps settle
+  // in two or three sweeps; each extra winding of a path around obstacles
+  // can cost another, though rows whose neighborhood did not change since
+  // they were last swept are skipped. Rows are processed with SSE2 or AVX2
+  // where available.
+  class ChamferMap {
+    public:
+    typedef DijkstraMap::Distance Distance;
+    typedef DijkstraMap::Goal Goal;
+    static constexpr Distance infinity = DijkstraMap::infinity;
+
+    ChamferMap() = default;
+    ChamferMap(const ChamferMap & other) = delete;
+    ChamferMap & operator=(const ChamferMap & other) = delete;
+
+    // true if every cell of `costs` is either impassable or costs the same,
+    // in which case that cost is written to `cost`
+    static bool is_uniform(const Map<unsigned int> & costs, unsigned int & cost);
+
+    // `costs` must be uniform
+    void compute(Map<Distance> & distances,
+                 const Map<unsigned int> & costs,
+                 Vec2u start);
+    void compute(Map<Distance> & distances,
+                 const Map<unsigned int> & costs,
+                 const std::vector<Vec2u> & start);
+    void compute(Map<Distance> & distances,
+                 const Map<unsigned int> & costs,
+                 const std::vector<Goal> & start);
+
+    // number of sweeps (forward and backward) used by the last compute
+    unsigned int sweep_count() const { return _sweep_count; }
+
+    static void test();
+
+    private:
+    // Distances and passability are stored with a one cell border of
+    // impassable, unreachable cells, so that rows can be read at x - 1 and
+    // x + 1 without bounds checks.
+    Vec2u grid_size;
+    unsigned int grid_stride = 0;
+    // cost of entering any passable cell
+    Distance cell_cost = 0;
+
+    std::vector<Distance> grid_distances;
+    // all bits set for passable cells, zero otherwise
+    std::vector<int32_t> grid_masks;
+
+    // per row: the step at which it last changed, and the steps at which it
+    // was last swept forward and backward
+    std::vector<unsigned int> row_changed;
+    std::vector<unsigned int> row_forward;
+    std::vector<unsigned int> row_backward;
+
+    unsigned int _sweep_count = 0;
+
+    unsigned int grid_index(Vec2u pos) const {
+      return (pos.x + 1) + (pos.y + 1)*grid_stride;
+    }
+
+    void init(const Map<unsigned int> & costs);
+    void seed(Vec2u pos, Distance distance);
+    void do_sweeps(Map<Distance> & distances);
+
+    bool sweep_row(unsigned int row_idx, unsigned int ref_idx);
+    bool scan_row_forward(unsigned int row_idx);
+    bool scan_row_backward(unsigned int row_idx);
+  };
+}
+
+#endif
@@ -0,0 +1,593 @@
+
+#include "ClusterGraph.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <random>
+
+namespace rf {
+  constexpr ClusterGraph::Distance ClusterGraph::infinity;
+
+  static const unsigned int no_node = std::numeric_limits<unsigned int>::max();
+
+  // runs of crossable border at least this long get an entrance at each end,
+  // shorter ones get a single entrance in the middle
+  static const unsigned int long_entrance_length = 6;
+
+  static const Vec2i neighbor_offsets[8] = {
+    Vec2i(-1, -1), Vec2i( 0, -1), Vec2i( 1, -1),
+    Vec2i(-1,  0),                Vec2i( 1,  0),
+    Vec2i(-1,  1), Vec2i( 0,  1), Vec2i( 1,  1),
+  };
+
+  static ClusterGraph::Distance chebyshev(Vec2u a, Vec2u b) {
+    int dx = std::abs((int)a.x - (int)b.x);
+    int dy = std::abs((int)a.y - (int)b.y);
+    return std::max(dx, dy);
+  }
+
+  ClusterGraph::ClusterGraph(unsigned int cluster_size)
+    : cluster_size(cluster_size) {
+    assert(cluster_size > 0);
+    local_dijkstra.set_queue_mode(DijkstraMap::BUCKET);
+  }
+
+  unsigned int ClusterGraph::cluster_index(Vec2u pos) const {
+    return (pos.y / cluster_size)*cluster_grid_size.x + pos.x / cluster_size;
+  }
+  unsigned int ClusterGraph::node_index(unsigned int cluster_idx, Vec2u pos) const {
+    const Cluster & cluster = clusters[cluster_idx];
+    for(unsigned int i = 0 ; i < cluster.nodes.size() ; i ++) {
+      if(cluster.nodes[i].pos == pos) {
+        return cluster.first_node + i;
+      }
+    }
+    // entrances are found from both sides of a border alike, so every exit
+    // leads to a node
+    assert(false);
+    return no_node;
+  }
+  bool ClusterGraph::passable(Vec2u pos) const {
+    return costs.valid(pos) && costs[pos] != DijkstraMap::impassable;
+  }
+
+  void ClusterGraph::add_node(Cluster & cluster, Vec2u pos, Vec2u exit) {
+    for(auto & node : cluster.nodes) {
+      if(node.pos == pos) {
+        if(std::find(node.exits.begin(), node.exits.end(), exit) == node.exits.end()) {
+          node.exits.push_back(exit);
+        }
+        return;
+      }
+    }
+
+    cluster.nodes.emplace_back();
+    cluster.nodes.back().pos = pos;
+    cluster.nodes.back().exits.push_back(exit);
+  }
+
+  void ClusterGraph::add_border_nodes(Cluster & cluster,
+                                      Vec2u a_begin,
+                                      Vec2u b_begin,
+                                      Vec2u step,
+                                      unsigned int length,
+                                      bool own_side_b) {
+    // side a is above or left of side b, so both clusters on a border
+    // place the same entrances
+    auto a_pos = [&](unsigned int i) {
+      return Vec2u(a_begin.x + step.x*i, a_begin.y + step.y*i);
+    };
+    auto b_pos = [&](unsigned int i) {
+      return Vec2u(b_begin.x + step.x*i, b_begin.y + step.y*i);
+    };
+    auto crossable = [&](unsigned int i) {
+      return passable(a_pos(i)) && passable(b_pos(i));
+    };
+    auto add_entrance = [&](Vec2u a, Vec2u b) {
+      if(own_side_b) {
+        add_node(cluster, b, a);
+      } else {
+        add_node(cluster, a, b);
+      }
+    };
+
+    // runs of straight crossings
+    unsigned int i = 0;
+    while(i < length) {
+      if(!crossable(i)) { i ++; continue; }
+
+      unsigned int j = i;
+      while(j < length && crossable(j)) { j ++; }
+
+      if(j - i < long_entrance_length) {
+        unsigned int k = (i + j - 1)/2;
+        add_entrance(a_pos(k), b_pos(k));
+      } else {
+        add_entrance(a_pos(i), b_pos(i));
+        add_entrance(a_pos(j - 1), b_pos(j - 1));
+      }
+
+      i = j;
+    }
+
+    // diagonal crossings, unless a straight crossing next to them already
+    // connects the same cells
+    for(i = 0 ; i + 1 < length ; i ++) {
+      if(crossable(i) || crossable(i + 1)) { continue; }
+
+      if(passable(a_pos(i)) && passable(b_pos(i + 1))) {
+        add_entrance(a_pos(i), b_pos(i + 1));
+      }
+      if(passable(a_pos(i + 1)) && passable(b_pos(i))) {
+        add_entrance(a_pos(i + 1), b_pos(i));
+      }
+    }
+  }
+
+  void ClusterGraph::add_corner_node(Cluster & cluster, Vec2u pos, Vec2i dir) {
+    Vec2u exit(pos.x + dir.x, pos.y + dir.y);
+    if(passable(pos) && passable(exit)) {
+      add_node(cluster, pos, exit);
+    }
+  }
+
+  void ClusterGraph::rebuild(unsigned int cluster_idx) {
+    Cluster & cluster = clusters[cluster_idx];
+    Vec2u cluster_pos(cluster_idx % cluster_grid_size.x, cluster_idx / cluster_grid_size.x);
+
+    Vec2u o = cluster.origin;
+    Vec2u s = cluster.size;
+
+    cluster.nodes.clear();
+
+    if(cluster_pos.y > 0) {
+      add_border_nodes(cluster, Vec2u(o.x, o.y - 1), Vec2u(o.x, o.y), Vec2u(1, 0), s.x, true);
+    }
+    if(cluster_pos.y + 1 < cluster_grid_size.y) {
+      add_border_nodes(cluster, Vec2u(o.x, o.y + s.y - 1), Vec2u(o.x, o.y + s.y), Vec2u(1, 0), s.x, false);
+    }
+    if(cluster_pos.x > 0) {
+      add_border_nodes(cluster, Vec2u(o.x - 1, o.y), Vec2u(o.x, o.y), Vec2u(0, 1), s.y, true);
+    }
+    if(cluster_pos.x + 1 < cluster_grid_size.x) {
+      add_border_nodes(cluster, Vec2u(o.x + s.x - 1, o.y), Vec2u(o.x + s.x, o.y), Vec2u(0, 1), s.y, false);
+    }
+
+    // corners step straight into diagonal clusters
+    add_corner_node(cluster, Vec2u(o.x, o.y), Vec2i(-1, -1));
+    add_corner_node(cluster, Vec2u(o.x + s.x - 1, o.y), Vec2i(1, -1));
+    add_corner_node(cluster, Vec2u(o.x, o.y + s.y - 1), Vec2i(-1, 1));
+    add_corner_node(cluster, Vec2u(o.x + s.x - 1, o.y + s.y - 1), Vec2i(1, 1));
+
+    // distances between every pair of entrances, without leaving the cluster
+    unsigned int node_num = cluster.nodes.size();
+    cluster.distances.assign(node_num*node_num, infinity);
+
+    if(node_num != 0) {
+      load_local_costs(cluster);
+
+      local_queries.clear();
+      for(auto & node : cluster.nodes) {
+        local_queries.push_back(Vec2u(node.pos.x - o.x, node.pos.y - o.y));
+      }
+
+      for(unsigned int i = 0 ; i < node_num ; i ++) {
+        local_dijkstra.compute(local_distances, local_costs, local_queries[i], local_queries);
+        for(unsigned int j = 0 ; j < node_num ; j ++) {
+          cluster.distances[i*node_num + j] = local_distances[local_queries[j]];
+        }
+      }
+    }
+
+    _rebuilt_count ++;
+  }
+
+  void ClusterGraph::index_nodes() {
+    node_clusters.clear();
+    for(unsigned int i = 0 ; i < clusters.size() ; i ++) {
+      clusters[i].first_node = node_clusters.size();
+      node_clusters.insert(node_clusters.end(), clusters[i].nodes.size(), i);
+    }
+  }
+
+  void ClusterGraph::load_local_costs(const Cluster & cluster) {
+    local_costs.resize(cluster.size);
+    for(unsigned int y = 0 ; y < cluster.size.y ; y ++) {
+      for(unsigned int x = 0 ; x < cluster.size.x ; x ++) {
+        local_costs[Vec2u(x, y)] = costs[Vec2u(cluster.origin.x + x, cluster.origin.y + y)];
+      }
+    }
+  }
+
+  void ClusterGraph::build(const Map<unsigned int> & new_costs) {
+    costs = new_costs;
+
+    Vec2u size = costs.size();
+    cluster_grid_size = Vec2u((size.x + cluster_size - 1)/cluster_size,
+                              (size.y + cluster_size - 1)/cluster_size);
+
+    clusters.clear();
+    clusters.resize(cluster_grid_size.x*cluster_grid_size.y);
+
+    for(unsigned int cy = 0 ; cy < cluster_grid_size.y ; cy ++) {
+      for(unsigned int cx = 0 ; cx < cluster_grid_size.x ; cx ++) {
+        Cluster & cluster = clusters[cy*cluster_grid_size.x + cx];
+        cluster.origin = Vec2u(cx*cluster_size, cy*cluster_size);
+        cluster.size = Vec2u(std::min(cluster_size, size.x - cluster.origin.x),
+                             std::min(cluster_size, size.y - cluster.origin.y));
+      }
+    }
+
+    for(unsigned int i = 0 ; i < clusters.size() ; i ++) {
+      rebuild(i);
+    }
+
+    index_nodes();
+  }
+
+  void ClusterGraph::update(const Map<unsigned int> & new_costs, const std::vector<Vec2u> & changed) {
+    assert(new_costs.size() == costs.size());
+
+    // entrances on a border depend on the cells on both sides of it, so the
+    // clusters around a changed cell are rebuilt along with its own
+    std::vector<unsigned int> dirty;
+    for(auto & pos : changed) {
+      costs[pos] = new_costs[pos];
+
+      int cx = pos.x / cluster_size;
+      int cy = pos.y / cluster_size;
+      for(int dy = -1 ; dy <= 1 ; dy ++) {
+        for(int dx = -1 ; dx <= 1 ; dx ++) {
+          Vec2u c(cx + dx, cy + dy);
+          if(c.x < cluster_grid_size.x && c.y < cluster_grid_size.y) {
+            dirty.push_back(c.y*cluster_grid_size.x + c.x);
+          }
+        }
+      }
+    }
+
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+    for(auto cluster_idx : dirty) {
+      rebuild(cluster_idx);
+    }
+
+    if(!dirty.empty()) {
+      index_nodes();
+    }
+  }
+
+  ClusterGraph::Distance ClusterGraph::find_abstract_path(std::vector<Vec2u> & path_out,
+                                                          Vec2u start_pos,
+                                                          Vec2u end_pos) {
+    path_out.clear();
+    _expanded_count = 0;
+
+    if(!costs.valid(start_pos) || !costs.valid(end_pos)) {
+      return infinity;
+    }
+    if(start_pos == end_pos) {
+      path_out.push_back(start_pos);
+      return 0;
+    }
+
+    unsigned int end_cluster_idx = cluster_index(end_pos);
+    const Cluster & end_cluster = clusters[end_cluster_idx];
+
+    // From the start to the entrances of the clusters it steps into, and to
+    // the end if the end shares one. A passable start can leave its cluster
+    // through the entrances alone, but an impassable one (such as a cell
+    // taken by whoever is walking) can only be stepped out of, so each of
+    // its neighbors seeds a search in its own cluster.
+    bool start_passable = passable(start_pos);
+    Distance direct_distance = infinity;
+
+    start_clusters.clear();
+    if(start_passable) {
+      start_clusters.push_back(cluster_index(start_pos));
+    } else {
+      for(auto & offset : neighbor_offsets) {
+        Vec2u pos(start_pos.x + offset.x, start_pos.y + offset.y);
+        if(passable(pos)) {
+          start_clusters.push_back(cluster_index(pos));
+        }
+      }
+      std::sort(start_clusters.begin(), start_clusters.end());
+      start_clusters.erase(std::unique(start_clusters.begin(), start_clusters.end()), start_clusters.end());
+    }
+
+    start_edges.clear();
+    for(auto cluster_idx : start_clusters) {
+      const Cluster & cluster = clusters[cluster_idx];
+      Vec2u o = cluster.origin;
+
+      local_goals.clear();
+      if(start_passable) {
+        local_goals.push_back(std::make_pair(Vec2u(start_pos.x - o.x, start_pos.y - o.y), 0));
+      } else {
+        for(auto & offset : neighbor_offsets) {
+          Vec2u pos(start_pos.x + offset.x, start_pos.y + offset.y);
+          if(passable(pos) && cluster_index(pos) == cluster_idx) {
+            local_goals.push_back(std::make_pair(Vec2u(pos.x - o.x, pos.y - o.y), (Distance)costs[pos]));
+          }
+        }
+      }
+
+      local_queries.clear();
+      for(auto & node : cluster.nodes) {
+        local_queries.push_back(Vec2u(node.pos.x - o.x, node.pos.y - o.y));
+      }
+      if(cluster_idx == end_cluster_idx) {
+        local_queries.push_back(Vec2u(end_pos.x - o.x, end_pos.y - o.y));
+      }
+
+      load_local_costs(cluster);
+      local_dijkstra.compute(local_distances, local_costs, local_goals, local_queries);
+
+      for(unsigned int i = 0 ; i < cluster.nodes.size() ; i ++) {
+        Distance distance = local_distances[local_queries[i]];
+        if(distance != infinity) {
+          start_edges.push_back(std::make_pair(cluster.first_node + i, distance));
+        }
+      }
+      if(cluster_idx == end_cluster_idx) {
+        direct_distance = local_distances[local_queries.back()];
+      }
+    }
+
+    // from the entrances of the end's cluster to the end. Searching outward
+    // from the end counts the cost of each entrance instead of the end's, but
+    // since both are fixed the cheapest path is the same either way.
+    end_distances.assign(end_cluster.nodes.size(), infinity);
+    if(passable(end_pos)) {
+      Vec2u o = end_cluster.origin;
+
+      local_queries.clear();
+      for(auto & node : end_cluster.nodes) {
+        local_queries.push_back(Vec2u(node.pos.x - o.x, node.pos.y - o.y));
+      }
+
+      load_local_costs(end_cluster);
+      local_dijkstra.compute(local_distances, local_costs, Vec2u(end_pos.x - o.x, end_pos.y - o.y), local_queries);
+
+      for(unsigned int i = 0 ; i < end_cluster.nodes.size() ; i ++) {
+        Distance distance = local_distances[local_queries[i]];
+        if(distance != infinity) {
+          end_distances[i] = distance - costs[end_cluster.nodes[i].pos] + costs[end_pos];
+        }
+      }
+    }
+
+    // A* over the entrances, with the start and end as two extra nodes
+    unsigned int node_num = node_clusters.size();
+    unsigned int start = node_num;
+    unsigned int end = node_num + 1;
+
+    auto node_pos = [&](unsigned int node) {
+      if(node == start) { return start_pos; }
+      if(node == end) { return end_pos; }
+      const Cluster & cluster = clusters[node_clusters[node]];
+      return cluster.nodes[node - cluster.first_node].pos;
+    };
+
+    node_distances.assign(node_num + 2, infinity);
+    node_from.assign(node_num + 2, no_node);
+
+    typedef std::pair<Distance, unsigned int> OpenNode;
+    std::priority_queue<OpenNode, std::vector<OpenNode>, std::greater<OpenNode>> open_set;
+
+    auto relax = [&](unsigned int from, unsigned int node, Distance distance) {
+      if(distance < node_distances[node]) {
+        node_distances[node] = distance;
+        node_from[node] = from;
+        // every step costs at least one, so this never overestimates
+        open_set.push(std::make_pair(distance + chebyshev(node_pos(node), end_pos), node));
+      }
+    };
+
+    node_distances[start] = 0;
+    open_set.push(std::make_pair(chebyshev(start_pos, end_pos), start));
+
+    while(!open_set.empty()) {
+      OpenNode top = open_set.top();
+      open_set.pop();
+
+      unsigned int current = top.second;
+      Distance distance = node_distances[current];
+
+      // skip stale entries left behind by later improvements
+      if(top.first != distance + chebyshev(node_pos(current), end_pos)) { continue; }
+
+      _expanded_count ++;
+
+      if(current == end) {
+        unsigned int node = end;
+        while(node != no_node) {
+          path_out.push_back(node_pos(node));
+          node = node_from[node];
+        }
+        return distance;
+      }
+
+      if(current == start) {
+        for(auto & edge : start_edges) {
+          relax(start, edge.first, edge.second);
+        }
+        if(direct_distance != infinity) {
+          relax(start, end, direct_distance);
+        }
+        continue;
+      }
+
+      unsigned int cluster_idx = node_clusters[current];
+      const Cluster & cluster = clusters[cluster_idx];
+      unsigned int i = current - cluster.first_node;
+      unsigned int cluster_node_num = cluster.nodes.size();
+
+      for(unsigned int j = 0 ; j < cluster_node_num ; j ++) {
+        Distance step = cluster.distances[i*cluster_node_num + j];
+        if(j != i && step != infinity) {
+          relax(current, cluster.first_node + j, distance + step);
+        }
+      }
+
+      for(auto & exit : cluster.nodes[i].exits) {
+        relax(current, node_index(cluster_index(exit), exit), distance + costs[exit]);
+      }
+
+      if(cluster_idx == end_cluster_idx && end_distances[i] != infinity) {
+        relax(current, end, distance + end_distances[i]);
+      }
+    }
+
+    return infinity;
+  }
+
+  bool ClusterGraph::find_path(std::vector<Vec2i> & path_out,
+                               Vec2i start_pos,
+                               Vec2i end_pos) {
+    path_out.clear();
+
+    std::vector<Vec2u> abstract_path;
+    if(find_abstract_path(abstract_path, start_pos, end_pos) == infinity) {
+      return false;
+    }
+
+    // abstract_path runs backwards; each hop is either one step, or a search
+    // within the one cluster both of its ends belong to
+    path_out.push_back(Vec2i(abstract_path.back()));
+
+    for(unsigned int k = abstract_path.size() - 1 ; k > 0 ; k --) {
+      Vec2u a = abstract_path[k];
+      Vec2u b = abstract_path[k - 1];
+
+      if(a == b) { continue; }
+
+      if(chebyshev(a, b) == 1) {
+        path_out.push_back(Vec2i(b));
+        continue;
+      }
+
+      const Cluster & cluster = clusters[cluster_index(b)];
+      Vec2i o(cluster.origin);
+
+      load_local_costs(cluster);
+
+      if(cluster_index(a) != cluster_index(b)) {
+        // an impassable start steps into b's cluster first, at the neighbor
+        // with the cheapest way on to b
+        local_dijkstra.compute(local_distances, local_costs, Vec2u(Vec2i(b) - o));
+
+        Vec2u entry;
+        Distance entry_distance = infinity;
+        for(auto & offset : neighbor_offsets) {
+          Vec2u pos(a.x + offset.x, a.y + offset.y);
+          if(passable(pos) && cluster_index(pos) == cluster_index(b)) {
+            Distance distance = local_distances[Vec2u(Vec2i(pos) - o)];
+            if(distance < entry_distance) {
+              entry = pos;
+              entry_distance = distance;
+            }
+          }
+        }
+
+        assert(entry_distance != infinity);
+        path_out.push_back(Vec2i(entry));
+        a = entry;
+
+        if(a == b) { continue; }
+      }
+
+      bool found = local_astar.find8(local_path, local_costs, Vec2i(a) - o, Vec2i(b) - o);
+      assert(found);
+      (void)found;
+
+      for(unsigned int i = local_path.size() - 1 ; i > 0 ; i --) {
+        path_out.push_back(local_path[i - 1] + o);
+      }
+    }
+
+    std::reverse(path_out.begin(), path_out.end());
+    return true;
+  }
+
+  void ClusterGraph::test() {
+    std::mt19937 gen(9);
+
+    DijkstraMap dm;
+    std::vector<Vec2i> path;
+    std::vector<Vec2u> abstract_path;
+    std::vector<Vec2u> fresh_abstract_path;
+
+    for(int i = 0 ; i < 20 ; i ++) {
+      Vec2u size(1 + gen() % 48, 1 + gen() % 48);
+      unsigned int wall_chance = gen() % 5;
+
+      Map<unsigned int> costs(size);
+      for(unsigned int y = 0 ; y < size.y ; y ++) {
+        for(unsigned int x = 0 ; x < size.x ; x ++) {
+          costs[Vec2u(x, y)] = (gen() % 10 < wall_chance) ? DijkstraMap::impassable : 1 + gen() % 3;
+        }
+      }
+
+      ClusterGraph graph(2 + gen() % 9);
+      graph.build(costs);
+
+      for(int round = 0 ; round < 4 ; round ++) {
+        for(int j = 0 ; j < 10 ; j ++) {
+          Vec2u start(gen() % size.x, gen() % size.y);
+          Vec2u end(gen() % size.x, gen() % size.y);
+
+          auto distances = dm.compute(costs, start);
+          Distance distance = graph.find_abstract_path(abstract_path, start, end);
+          (void)distance;
+
+          // every crossing is an entrance, so paths can be longer than the
+          // best one, but are found whenever one exists
+          assert((distance == infinity) == (distances[end] == infinity));
+          assert(distance >= distances[end]);
+
+          bool found = graph.find_path(path, start, end);
+          assert(found == (distance != infinity));
+
+          if(found) {
+            assert(path.front() == Vec2i(end));
+            assert(path.back() == Vec2i(start));
+
+            Distance path_cost = 0;
+            for(unsigned int k = 0 ; k + 1 < path.size() ; k ++) {
+              assert(chebyshev(path[k], path[k + 1]) == 1);
+              assert(costs[path[k]] != DijkstraMap::impassable);
+              path_cost += costs[path[k]];
+            }
+            assert(path_cost == distance);
+          }
+        }
+
+        // change a few cells, and compare against a graph built from scratch
+        std::vector<Vec2u> changed;
+        for(unsigned int j = 0 ; j < 1 + gen() % 6 ; j ++) {
+          Vec2u p(gen() % size.x, gen() % size.y);
+          costs[p] = (gen() % 2) ? DijkstraMap::impassable : 1 + gen() % 3;
+          changed.push_back(p);
+        }
+        graph.update(costs, changed);
+
+        ClusterGraph fresh(graph.cluster_size);
+        fresh.build(costs);
+        assert(fresh.node_count() == graph.node_count());
+
+        for(int j = 0 ; j < 10 ; j ++) {
+          Vec2u start(gen() % size.x, gen() % size.y);
+          Vec2u end(gen() % size.x, gen() % size.y);
+          assert(graph.find_abstract_path(abstract_path, start, end) ==
+                 fresh.find_abstract_path(fresh_abstract_path, start, end));
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,115 @@
+#ifndef RF_UTIL_CLUSTERGRAPH_HPP
+#define RF_UTIL_CLUSTERGRAPH_HPP
+
+#include <vector>
+
+#include <rf/util/Vec2.hpp>
+#include <rf/util/Map.hpp>
+#include <rf/util/Dijkstra.hpp>
+#include <rf/util/AStar.hpp>
+
+namespace rf {
+  // Hierarchical (HPA*) view of a cost map, using the same moves and costs as
+  // DoAStar8. The map is cut into square clusters, and the cells on either
+  // side of each cluster border where it can be crossed become entrance
+  // nodes. Distances between the entrances of a cluster are precomputed, so
+  // that a long query searches a graph of a few nodes per cluster. Paths are
+  // near-optimal: every crossing between clusters happens at an entrance.
+  class ClusterGraph {
+    public:
+    typedef DijkstraMap::Distance Distance;
+    static constexpr Distance infinity = DijkstraMap::infinity;
+
+    ClusterGraph(unsigned int cluster_size = 16);
+    ClusterGraph(const ClusterGraph & other) = delete;
+    ClusterGraph & operator=(const ClusterGraph & other) = delete;
+
+    // Builds every cluster from a copy of `costs`.
+    void build(const Map<unsigned int> & costs);
+    // Copies the cost of the cells in `changed` from `costs`, and rebuilds
+    // only the clusters which those cells (and the borders they lie on) touch.
+    void update(const Map<unsigned int> & costs, const std::vector<Vec2u> & changed);
+
+    // Finds the entrances a path from `start_pos` to `end_pos` passes
+    // through, and writes them from `end_pos` back to `start_pos` (both
+    // inclusive) into `path_out`. Returns the cost of the path, or infinity.
+    Distance find_abstract_path(std::vector<Vec2u> & path_out,
+                                Vec2u start_pos,
+                                Vec2u end_pos);
+    // As above, but refined into every cell, in the format of DoAStar8.
+    bool find_path(std::vector<Vec2i> & path_out,
+                   Vec2i start_pos,
+                   Vec2i end_pos);
+
+    Vec2u size() const { return costs.size(); }
+    unsigned int cluster_count() const { return clusters.size(); }
+    unsigned int node_count() const { return node_clusters.size(); }
+    // number of abstract nodes closed by the last query
+    unsigned int expanded_count() const { return _expanded_count; }
+    // number of clusters rebuilt by build() and update() so far
+    unsigned int rebuilt_count() const { return _rebuilt_count; }
+
+    static void test();
+
+    private:
+    struct Node {
+      Vec2u pos;
+      // cells in other clusters this node steps into when leaving its own
+      std::vector<Vec2u> exits;
+    };
+    struct Cluster {
+      Vec2u origin;
+      Vec2u size;
+      std::vector<Node> nodes;
+      // distance from node i to node j is at i*nodes.size() + j
+      std::vector<Distance> distances;
+      unsigned int first_node = 0;
+    };
+
+    unsigned int cluster_size;
+    Vec2u cluster_grid_size;
+
+    Map<unsigned int> costs;
+    std::vector<Cluster> clusters;
+    // the cluster of every node, indexed by first_node + local index
+    std::vector<unsigned int> node_clusters;
+
+    // scratch space for searches confined to one cluster
+    DijkstraMap local_dijkstra;
+    AStarSearch local_astar;
+    Map<unsigned int> local_costs;
+    Map<Distance> local_distances;
+    std::vector<DijkstraMap::Goal> local_goals;
+    std::vector<Vec2u> local_queries;
+    std::vector<Vec2i> local_path;
+
+    // scratch space for the abstract search
+    std::vector<Distance> node_distances;
+    std::vector<unsigned int> node_from;
+    std::vector<unsigned int> start_clusters;
+    std::vector<std::pair<unsigned int, Distance>> start_edges;
+    std::vector<Distance> end_distances;
+
+    unsigned int _expanded_count = 0;
+    unsigned int _rebuilt_count = 0;
+
+    unsigned int cluster_index(Vec2u pos) const;
+    unsigned int node_index(unsigned int cluster, Vec2u pos) const;
+    bool passable(Vec2u pos) const;
+
+    void add_node(Cluster & cluster, Vec2u pos, Vec2u exit);
+    void add_border_nodes(Cluster & cluster,
+                          Vec2u a_begin,
+                          Vec2u b_begin,
+                          Vec2u step,
+                          unsigned int length,
+                          bool own_side_b);
+    void add_corner_node(Cluster & cluster, Vec2u pos, Vec2i dir);
+    void rebuild(unsigned int cluster);
+    void index_nodes();
+
+    void load_local_costs(const Cluster & cluster);
+  };
+}
+
+#endif
@@ -1,12 +1,35 @@
 
 #include "Dijkstra.hpp"
 
+#include <rf/util/ThreadPool.hpp>
+
 #include <cassert>
 #include <utility>
+#include <algorithm>
+#include <queue>
+#include <random>
 
 namespace rf {
-  DijkstraMap::~DijkstraMap() {
-    delete [] graph_nodes;
+  constexpr DijkstraMap::Distance DijkstraMap::infinity;
+  constexpr unsigned int DijkstraMap::impassable;
+  constexpr unsigned int DijkstraMap::max_bucket_cost;
+  constexpr uint32_t DijkstraMap::no_heap_index;
+
+  // neighbor offsets, in the same order as DijkstraMap::neighbor_steps
+  static const Vec2i neighbor_offsets[8] = {
+    Vec2i( 1,  0), Vec2i( 1,  1), Vec2i( 0,  1), Vec2i(-1,  1),
+    Vec2i(-1,  0), Vec2i(-1, -1), Vec2i( 0, -1), Vec2i( 1, -1),
+  };
+
+  // distance of a cell with `cost`, entered from a cell at `distance`, or
+  // infinity if it cannot be entered (same wraparound rule as do_dijkstra)
+  static DijkstraMap::Distance relax(DijkstraMap::Distance distance, unsigned int cost) {
+    DijkstraMap::Distance possible_distance = distance + cost;
+    if(possible_distance >= distance) {
+      return possible_distance;
+    } else {
+      return DijkstraMap::infinity;
+    }
   }
 
   void DijkstraMap::compute(Map<Distance> & distances,
@@ -34,6 +57,131 @@ namespace rf {
     do_dijkstra(distances_out);
   }
 
+  void DijkstraMap::update(Map<Distance> & distances,
+                           const Map<unsigned int> & costs,
+                           Vec2u start,
+                           const std::vector<Vec2u> & changed) {
+    do_repair(distances, costs, { std::make_pair(start, 0) }, changed);
+  }
+  void DijkstraMap::update(Map<Distance> & distances,
+                           const Map<unsigned int> & costs,
+                           const std::vector<Vec2u> & start,
+                           const std::vector<Vec2u> & changed) {
+    std::vector<Goal> goals;
+    goals.reserve(start.size());
+    for(auto & p : start) {
+      goals.push_back(std::make_pair(p, 0));
+    }
+    do_repair(distances, costs, goals, changed);
+  }
+  void DijkstraMap::update(Map<Distance> & distances,
+                           const Map<unsigned int> & costs,
+                           const std::vector<Goal> & start,
+                           const std::vector<Vec2u> & changed) {
+    do_repair(distances, costs, start, changed);
+  }
+
+  void DijkstraMap::compute(Map<Distance> & distances,
+                            const Map<unsigned int> & costs,
+                            Vec2u start,
+                            Distance max_distance) {
+    init(costs, start);
+    do_dijkstra(distances, max_distance);
+  }
+  void DijkstraMap::compute(Map<Distance> & distances,
+                            const Map<unsigned int> & costs,
+                            const std::vector<Vec2u> & start,
+                            Distance max_distance) {
+    init(costs, start);
+    do_dijkstra(distances, max_distance);
+  }
+  void DijkstraMap::compute(Map<Distance> & distances,
+                            const Map<unsigned int> & costs,
+                            const std::vector<Goal> & start,
+                            Distance max_distance) {
+    init(costs, start);
+    do_dijkstra(distances, max_distance);
+  }
+
+  void DijkstraMap::compute(Map<Distance> & distances,
+                            const Map<unsigned int> & costs,
+                            Vec2u start,
+                            const std::vector<Vec2u> & queries) {
+    init(costs, start);
+    do_dijkstra(distances, queries);
+  }
+  void DijkstraMap::compute(Map<Distance> & distances,
+                            const Map<unsigned int> & costs,
+                            const std::vector<Vec2u> & start,
+                            const std::vector<Vec2u> & queries) {
+    init(costs, start);
+    do_dijkstra(distances, queries);
+  }
+  void DijkstraMap::compute(Map<Distance> & distances,
+                            const Map<unsigned int> & costs,
+                            const std::vector<Goal> & start,
+                            const std::vector<Vec2u> & queries) {
+    init(costs, start);
+    do_dijkstra(distances, queries);
+  }
+
+  void DijkstraMap::compute_batch(std::vector<Map<Distance>> & distances,
+                                  const Map<unsigned int> & costs,
+                                  const std::vector<std::vector<Goal>> & starts,
+                                  ThreadPool * pool) {
+#ifndef NDEBUG
+    for(auto & start : starts) {
+      for(auto & p : start) {
+        assert(costs.valid(p.first));
+      }
+    }
+#endif
+    init_graph(costs);
+
+    distances.resize(starts.size());
+
+    unsigned int worker_num = pool ? pool->size() : 1;
+    if(batch_searches.size() < worker_num) {
+      batch_searches.resize(worker_num);
+    }
+
+    auto task = [this, &distances, &starts](unsigned int i, unsigned int worker) {
+      Search & s = batch_searches[worker];
+      init_search(s);
+      for(auto & p : starts[i]) {
+        seed(s, node_index(p.first), p.second);
+      }
+      do_dijkstra(s, distances[i]);
+    };
+
+    if(pool) {
+      pool->run(starts.size(), task);
+    } else {
+      for(unsigned int i = 0 ; i < starts.size() ; i ++) {
+        task(i, 0);
+      }
+    }
+  }
+
+  size_t DijkstraMap::memory_usage() const {
+    size_t bytes = node_costs.capacity()*sizeof(unsigned int) +
+                   search.memory_usage();
+    for(auto & s : batch_searches) {
+      bytes += s.memory_usage();
+    }
+    return bytes;
+  }
+  size_t DijkstraMap::Search::memory_usage() const {
+    size_t bytes = node_distances.capacity()*sizeof(Distance) +
+                   node_heap_indices.capacity()*sizeof(uint32_t) +
+                   heap_nodes.capacity()*sizeof(NodeIndex) +
+                   bucket_seeds.capacity()*sizeof(bucket_seeds[0]);
+    for(auto & bucket : buckets) {
+      bytes += bucket.capacity()*sizeof(NodeIndex);
+    }
+    return bytes;
+  }
+
   void DijkstraMap::test_heap() {
     rf::DijkstraMap dm;
 
@@ -41,68 +189,283 @@ namespace rf {
     costs.fill(1);
     dm.init(costs, Vec2u(1, 1));
 
+    // graph index of the k-th cell, in raster order
+    auto node = [&dm](unsigned int k) {
+      return dm.node_index(Vec2u(k % 3, k / 3));
+    };
+    (void)node;
+
     assert(dm.graph_size == Vec2u(3, 3));
-    assert(dm.heap_size == 9);
+    assert(dm.search.heap_size == 9);
 
-    assert(dm.heap_nodes[0]->distance == 0);
+    assert(dm.search.node_distances[dm.search.heap_nodes[0]] == 0);
     for(int i = 1 ; i < 9 ; i ++) {
-      assert(dm.heap_nodes[i]->distance == infinity);
+      assert(dm.search.node_distances[dm.search.heap_nodes[i]] == infinity);
     }
 
-    // heap_nodes[0,1,4] should have had their `graph_node` cycled from percolation
-    assert(dm.heap_nodes[0] == &dm.graph_nodes[4]);
-    assert(dm.heap_nodes[1] == &dm.graph_nodes[0]);
-    assert(dm.heap_nodes[2] == &dm.graph_nodes[2]);
-    assert(dm.heap_nodes[3] == &dm.graph_nodes[3]);
-    assert(dm.heap_nodes[4] == &dm.graph_nodes[1]);
-    assert(dm.heap_nodes[5] == &dm.graph_nodes[5]);
-    assert(dm.heap_nodes[6] == &dm.graph_nodes[6]);
-    assert(dm.heap_nodes[7] == &dm.graph_nodes[7]);
-    assert(dm.heap_nodes[8] == &dm.graph_nodes[8]);
-
-    GraphNode * node = dm.heap_pop();
-    assert(dm.heap_size == 8);
-    assert(node == &dm.graph_nodes[4]);
-    assert(node->distance == 0);
+    // heap_nodes[0,1,4] should have had their nodes cycled from percolation
+    assert(dm.search.heap_nodes[0] == node(4));
+    assert(dm.search.heap_nodes[1] == node(0));
+    assert(dm.search.heap_nodes[2] == node(2));
+    assert(dm.search.heap_nodes[3] == node(3));
+    assert(dm.search.heap_nodes[4] == node(1));
+    assert(dm.search.heap_nodes[5] == node(5));
+    assert(dm.search.heap_nodes[6] == node(6));
+    assert(dm.search.heap_nodes[7] == node(7));
+    assert(dm.search.heap_nodes[8] == node(8));
+
+    NodeIndex top = dm.search.heap_pop();
+    (void)top;
+    assert(dm.search.heap_size == 8);
+    assert(top == node(4));
+    assert(dm.search.node_distances[top] == 0);
 
     // the tree should be the same, except the top node is now the old last node
-    assert(dm.heap_nodes[0] == &dm.graph_nodes[8]);
-    assert(dm.heap_nodes[1] == &dm.graph_nodes[0]);
-    assert(dm.heap_nodes[2] == &dm.graph_nodes[2]);
-    assert(dm.heap_nodes[3] == &dm.graph_nodes[3]);
-    assert(dm.heap_nodes[4] == &dm.graph_nodes[1]);
-    assert(dm.heap_nodes[5] == &dm.graph_nodes[5]);
-    assert(dm.heap_nodes[6] == &dm.graph_nodes[6]);
-    assert(dm.heap_nodes[7] == &dm.graph_nodes[7]);
-
-    dm.heap_decrease(dm.heap_nodes[7], 4545);
-    assert(dm.heap_nodes[0]->distance == 4545);
-    assert(dm.heap_nodes[0] == &dm.graph_nodes[7]);
-
-    dm.heap_decrease(dm.heap_nodes[7], 3434);
-    assert(dm.heap_nodes[0]->distance == 3434);
-    assert(dm.heap_nodes[0] == &dm.graph_nodes[3]);
-
-    dm.heap_decrease(dm.heap_nodes[7], 2323);
-    assert(dm.heap_nodes[0]->distance == 2323);
-    assert(dm.heap_nodes[0] == &dm.graph_nodes[0]);
-
-    dm.heap_decrease(dm.heap_nodes[7], 1212);
-    assert(dm.heap_nodes[0]->distance == 1212);
-    assert(dm.heap_nodes[0] == &dm.graph_nodes[8]);
-
-    dm.heap_decrease(dm.heap_nodes[7],  101);
-    assert(dm.heap_nodes[0]->distance ==  101);
-    assert(dm.heap_nodes[0] == &dm.graph_nodes[7]);
-
-    assert(dm.heap_pop() == &dm.graph_nodes[7]);
-    assert(dm.heap_size == 7);
-    assert(dm.heap_pop() == &dm.graph_nodes[8]);
-    assert(dm.heap_size == 6);
-    assert(dm.heap_pop() == &dm.graph_nodes[0]);
-    assert(dm.heap_size == 5);
-    assert(dm.heap_pop() == &dm.graph_nodes[3]);
-    assert(dm.heap_size == 4);
+    assert(dm.search.heap_nodes[0] == node(8));
+    assert(dm.search.heap_nodes[1] == node(0));
+    assert(dm.search.heap_nodes[2] == node(2));
+    assert(dm.search.heap_nodes[3] == node(3));
+    assert(dm.search.heap_nodes[4] == node(1));
+    assert(dm.search.heap_nodes[5] == node(5));
+    assert(dm.search.heap_nodes[6] == node(6));
+    assert(dm.search.heap_nodes[7] == node(7));
+
+    dm.search.heap_decrease(dm.search.heap_nodes[7], 4545);
+    assert(dm.search.node_distances[dm.search.heap_nodes[0]] == 4545);
+    assert(dm.search.heap_nodes[0] == node(7));
+
+    dm.search.heap_decrease(dm.search.heap_nodes[7], 3434);
+    assert(dm.search.node_distances[dm.search.heap_nodes[0]] == 3434);
+    assert(dm.search.heap_nodes[0] == node(3));
+
+    dm.search.heap_decrease(dm.search.heap_nodes[7], 2323);
+    assert(dm.search.node_distances[dm.search.heap_nodes[0]] == 2323);
+    assert(dm.search.heap_nodes[0] == node(0));
+
+    dm.search.heap_decrease(dm.search.heap_nodes[7], 1212);
+    assert(dm.search.node_distances[dm.search.heap_nodes[0]] == 1212);
+    assert(dm.search.heap_nodes[0] == node(8));
+
+    dm.search.heap_decrease(dm.search.heap_nodes[7],  101);
+    assert(dm.search.node_distances[dm.search.heap_nodes[0]] ==  101);
+    assert(dm.search.heap_nodes[0] == node(7));
+
+    assert(dm.search.heap_pop() == node(7));
+    assert(dm.search.heap_size == 7);
+    assert(dm.search.heap_pop() == node(8));
+    assert(dm.search.heap_size == 6);
+    assert(dm.search.heap_pop() == node(0));
+    assert(dm.search.heap_size == 5);
+    assert(dm.search.heap_pop() == node(3));
+    assert(dm.search.heap_size == 4);
+  }
+  void DijkstraMap::test_buckets() {
+    rf::DijkstraMap heap_dm;
+    rf::DijkstraMap bucket_dm;
+    bucket_dm.set_queue_mode(BUCKET);
+
+    const Vec2u size(24, 24);
+
+    std::mt19937 gen(1);
+
+    rf::Map<unsigned int> costs(size);
+    rf::Map<Distance> start(size);
+    for(unsigned int y = 0 ; y < size.y ; y ++) {
+      for(unsigned int x = 0 ; x < size.x ; x ++) {
+        switch(gen() % 8) {
+          case 0:
+            costs[Vec2u(x, y)] = impassable;
+            break;
+          case 1:
+            costs[Vec2u(x, y)] = 0;
+            break;
+          default:
+            costs[Vec2u(x, y)] = 1 + gen() % 5;
+            break;
+        }
+        if(gen() % 16 == 0) {
+          start[Vec2u(x, y)] = (int)(gen() % 40) - 20;
+        } else {
+          start[Vec2u(x, y)] = infinity;
+        }
+      }
+    }
+
+    std::vector<Goal> goals = { std::make_pair(Vec2u(1, 1), -5),
+                                std::make_pair(Vec2u(20, 3), 0),
+                                std::make_pair(Vec2u(5, 17), 7) };
+
+    auto heap_map = heap_dm.compute(costs, goals);
+    auto bucket_map = bucket_dm.compute(costs, goals);
+    for(unsigned int y = 0 ; y < size.y ; y ++) {
+      for(unsigned int x = 0 ; x < size.x ; x ++) {
+        assert(heap_map[Vec2u(x, y)] == bucket_map[Vec2u(x, y)]);
+      }
+    }
+
+    heap_map = heap_dm.compute(costs, start);
+    bucket_map = bucket_dm.compute(costs, start);
+    for(unsigned int y = 0 ; y < size.y ; y ++) {
+      for(unsigned int x = 0 ; x < size.x ; x ++) {
+        assert(heap_map[Vec2u(x, y)] == bucket_map[Vec2u(x, y)]);
+      }
+    }
+  }
+  void DijkstraMap::test_batch() {
+    rf::DijkstraMap dm;
+    rf::ThreadPool pool(3);
+
+    const Vec2u size(20, 16);
+
+    std::mt19937 gen(2);
+
+    rf::Map<unsigned int> costs(size);
+    for(unsigned int y = 0 ; y < size.y ; y ++) {
+      for(unsigned int x = 0 ; x < size.x ; x ++) {
+        costs[Vec2u(x, y)] = (gen() % 6 == 0) ? impassable : 1 + gen() % 3;
+      }
+    }
+
+    std::vector<std::vector<Goal>> starts;
+    for(int i = 0 ; i < 10 ; i ++) {
+      starts.emplace_back();
+      for(int j = 0 ; j <= i % 3 ; j ++) {
+        Vec2u p(gen() % size.x, gen() % size.y);
+        starts.back().push_back(std::make_pair(p, (int)(gen() % 10) - 5));
+      }
+    }
+
+    std::vector<Map<Distance>> serial_maps;
+    std::vector<Map<Distance>> pool_maps;
+    dm.compute_batch(serial_maps, costs, starts);
+    dm.compute_batch(pool_maps, costs, starts, &pool);
+
+    assert(serial_maps.size() == starts.size());
+    assert(pool_maps.size() == starts.size());
+
+    for(unsigned int i = 0 ; i < starts.size() ; i ++) {
+      auto expected = dm.compute(costs, starts[i]);
+      for(unsigned int y = 0 ; y < size.y ; y ++) {
+        for(unsigned int x = 0 ; x < size.x ; x ++) {
+          assert(serial_maps[i][Vec2u(x, y)] == expected[Vec2u(x, y)]);
+          assert(pool_maps[i][Vec2u(x, y)] == expected[Vec2u(x, y)]);
+        }
+      }
+    }
+  }
+  void DijkstraMap::test_bounded() {
+    for(auto mode : { HEAP, BUCKET }) {
+      rf::DijkstraMap dm;
+      dm.set_queue_mode(mode);
+
+      const Vec2u size(30, 20);
+
+      std::mt19937 gen(3);
+
+      rf::Map<unsigned int> costs(size);
+      for(unsigned int y = 0 ; y < size.y ; y ++) {
+        for(unsigned int x = 0 ; x < size.x ; x ++) {
+          costs[Vec2u(x, y)] = (gen() % 6 == 0) ? impassable : 1 + gen() % 3;
+        }
+      }
+
+      std::vector<Goal> goals = { std::make_pair(Vec2u(4, 4), 0),
+                                  std::make_pair(Vec2u(25, 15), -2) };
+
+      auto expected = dm.compute(costs, goals);
+
+      for(Distance max_distance : { -5, 0, 3, 10, 25 }) {
+        Map<Distance> map;
+        dm.compute(map, costs, goals, max_distance);
+        for(unsigned int y = 0 ; y < size.y ; y ++) {
+          for(unsigned int x = 0 ; x < size.x ; x ++) {
+            Distance d = expected[Vec2u(x, y)];
+            (void)d;
+            assert(map[Vec2u(x, y)] == (d <= max_distance ? d : infinity));
+          }
+        }
+      }
+
+      for(int i = 0 ; i < 10 ; i ++) {
+        std::vector<Vec2u> queries;
+        for(int j = 0 ; j <= i % 4 ; j ++) {
+          queries.push_back(Vec2u(gen() % size.x, gen() % size.y));
+        }
+
+        Map<Distance> map;
+        dm.compute(map, costs, goals, queries);
+
+        for(auto & q : queries) {
+          (void)q;
+          assert(map[q] == expected[q]);
+        }
+        for(unsigned int y = 0 ; y < size.y ; y ++) {
+          for(unsigned int x = 0 ; x < size.x ; x ++) {
+            Distance d = map[Vec2u(x, y)];
+            (void)d;
+            assert(d == infinity || d == expected[Vec2u(x, y)]);
+          }
+        }
+      }
+    }
+  }
+  void DijkstraMap::test_update() {
+    rf::DijkstraMap dm;
+
+    const Vec2u size(32, 32);
+
+    std::mt19937 gen(0);
+    auto random_cost = [&gen]() -> unsigned int {
+      switch(gen() % 8) {
+        case 0:
+          return 0xFFFFFFFF;
+        case 1:
+          return 0;
+        default:
+          return 1 + gen() % 3;
+      }
+    };
+    auto random_pos = [&gen, size]() {
+      unsigned int x = gen() % size.x;
+      unsigned int y = gen() % size.y;
+      return Vec2u(x, y);
+    };
+
+    rf::Map<unsigned int> costs(size);
+    for(unsigned int y = 0 ; y < size.y ; y ++) {
+      for(unsigned int x = 0 ; x < size.x ; x ++) {
+        costs[Vec2u(x, y)] = random_cost();
+      }
+    }
+
+    std::vector<Goal> goals = { std::make_pair(Vec2u(3, 4), 0),
+                                std::make_pair(Vec2u(20, 25), -3) };
+
+    auto map = dm.compute(costs, goals);
+
+    for(int i = 0 ; i < 200 ; i ++) {
+      std::vector<Vec2u> changed;
+
+      for(int j = 0 ; j < 3 ; j ++) {
+        Vec2u p = random_pos();
+        costs[p] = random_cost();
+        changed.push_back(p);
+      }
+
+      auto & goal = goals[gen() % goals.size()];
+      changed.push_back(goal.first);
+      goal.first = random_pos();
+      changed.push_back(goal.first);
+
+      dm.update(map, costs, goals, changed);
+
+      auto expected = dm.compute(costs, goals);
+      for(unsigned int y = 0 ; y < size.y ; y ++) {
+        for(unsigned int x = 0 ; x < size.x ; x ++) {
+          assert(map[Vec2u(x, y)] == expected[Vec2u(x, y)]);
+        }
+      }
+    }
   }
   void DijkstraMap::test() {
     test_heap();
@@ -177,83 +540,73 @@ namespace rf {
     assert(size.x != 0);
     assert(size.y != 0);
 
-    unsigned int node_num = size.x * size.y;
-
-    // reallocate if we need more space
-    if(node_num > graph_size.x * graph_size.y) {
-      delete [] graph_nodes;
-      graph_nodes = new GraphNode [node_num];
-      delete [] heap_nodes;
-      heap_nodes = new HeapNode [node_num];
-    }
     graph_size = size;
-    heap_size = node_num;
+    graph_stride = size.x + 2;
 
-    unsigned int idx = 0;
-    for(unsigned int y = 0 ; y < size.x ; y ++) {
-      for(unsigned int x = 0 ; x < size.x ; x ++) {
-        auto & node = graph_nodes[idx];
+    unsigned int node_num = (size.x + 2) * (size.y + 2);
 
-        // neighbor 0: x + 1, y
-        if(x < size.x - 1) {
-          node.neighbors[0] = &graph_nodes[(x + 1) + (y)*size.x];
-        } else {
-          node.neighbors[0] = nullptr;
-        }
+    // 0: x + 1, y      1: x + 1, y + 1  2: x, y + 1      3: x - 1, y + 1
+    // 4: x - 1, y      5: x - 1, y - 1  6: x, y - 1      7: x + 1, y - 1
+    int stride = graph_stride;
+    neighbor_steps[0] =  1;
+    neighbor_steps[1] =  1 + stride;
+    neighbor_steps[2] =      stride;
+    neighbor_steps[3] = -1 + stride;
+    neighbor_steps[4] = -1;
+    neighbor_steps[5] = -1 - stride;
+    neighbor_steps[6] =    - stride;
+    neighbor_steps[7] =  1 - stride;
 
-        // neighbor 1: x + 1, y + 1
-        if(x < size.x - 1 && y < size.y - 1) {
-          node.neighbors[1] = &graph_nodes[(x + 1) + (y + 1)*size.x];
-        } else {
-          node.neighbors[1] = nullptr;
-        }
+    // only reallocates if we need more space
+    node_costs.resize(node_num);
 
-        // neighbor 2: x, y + 1
-        if(y < size.y - 1) {
-          node.neighbors[2] = &graph_nodes[(x) + (y + 1)*size.x];
-        } else {
-          node.neighbors[2] = nullptr;
-        }
+    // the border is never entered
+    std::fill(node_costs.begin(), node_costs.begin() + graph_stride, impassable);
+    std::fill(node_costs.end() - graph_stride, node_costs.end(), impassable);
 
-        // neighbor 3: x - 1, y + 1
-        if(x > 0 && y < size.y - 1) {
-          node.neighbors[3] = &graph_nodes[(x - 1) + (y + 1)*size.x];
-        } else {
-          node.neighbors[3] = nullptr;
-        }
+    max_cost = 0;
 
-        // neighbor 4: x - 1, y
-        if(x > 0) {
-          node.neighbors[4] = &graph_nodes[(x - 1) + (y)*size.x];
-        } else {
-          node.neighbors[4] = nullptr;
-        }
+    for(unsigned int y = 0 ; y < size.y ; y ++) {
+      NodeIndex idx = node_index(Vec2u(0, y));
 
-        // neighbor 5: x - 1, y - 1
-        if(x > 0 && y > 0) {
-          node.neighbors[5] = &graph_nodes[(x - 1) + (y - 1)*size.x];
-        } else {
-          node.neighbors[5] = nullptr;
-        }
+      node_costs[idx - 1] = impassable;
+      node_costs[idx + size.x] = impassable;
 
-        // neighbor 6: x, y - 1
-        if(y > 0) {
-          node.neighbors[6] = &graph_nodes[(x) + (y - 1)*size.x];
-        } else {
-          node.neighbors[6] = nullptr;
-        }
+      const unsigned int * row = costs.data() + y*size.x;
 
-        // neighbor 7: x + 1, y - 1
-        if(x < size.x - 1 && y > 0) {
-          node.neighbors[7] = &graph_nodes[(x + 1) + (y - 1)*size.x];
-        } else {
-          node.neighbors[7] = nullptr;
+      for(unsigned int x = 0 ; x < size.x ; x ++) {
+        unsigned int cost = row[x];
+        if(cost != impassable && cost > max_cost) {
+          max_cost = cost;
         }
+        node_costs[idx + x] = cost;
+      }
+    }
+
+    use_buckets = _queue_mode == BUCKET && max_cost <= max_bucket_cost;
+  }
+  void DijkstraMap::init_search(Search & s) const {
+    unsigned int node_num = node_costs.size();
+
+    // only reallocates if we need more space
+    s.node_distances.resize(node_num);
+    s.node_heap_indices.resize(node_num);
+    s.heap_nodes.resize(graph_size.x * graph_size.y);
+
+    std::fill(s.node_distances.begin(), s.node_distances.end(), infinity);
 
-        node.distance = infinity;
-        node.cost = costs[Vec2u(x, y)];
-        node.heap_node = &heap_nodes[idx];
-        heap_nodes[idx] = &graph_nodes[idx];
+    // the border is never placed in the heap
+    std::fill(s.node_heap_indices.begin(), s.node_heap_indices.end(), no_heap_index);
+
+    s.heap_size = 0;
+
+    for(unsigned int y = 0 ; y < graph_size.y ; y ++) {
+      NodeIndex idx = node_index(Vec2u(0, y));
+
+      for(unsigned int x = 0 ; x < graph_size.x ; x ++) {
+        s.node_heap_indices[idx] = s.heap_size;
+        s.heap_nodes[s.heap_size] = idx;
+        s.heap_size ++;
         idx ++;
       }
     }
@@ -261,21 +614,19 @@ namespace rf {
   void DijkstraMap::init(const Map<unsigned int> & costs, Vec2u start) {
     assert(costs.valid(start));
     init_graph(costs);
+    init_search(search);
 
-    // Update the starting node's distance
-    GraphNode * start_node = &graph_nodes[(start.x) + (start.y)*costs.size().x];
-    // Update it in the heap
-    heap_decrease(start_node, 0);
+    seed(search, node_index(start), 0);
   }
   void DijkstraMap::init(const Map<unsigned int> & costs, const std::vector<Vec2u> & start) {
     for(auto & p : start) {
       assert(costs.valid(p));
     }
     init_graph(costs);
+    init_search(search);
 
     for(auto & p : start) {
-      GraphNode * start_node = &graph_nodes[(p.x) + (p.y)*costs.size().x];
-      heap_decrease(start_node, 0);
+      seed(search, node_index(p), 0);
     }
   }
   void DijkstraMap::init(const Map<unsigned int> & costs, const std::vector<Goal> & start) {
@@ -283,171 +634,445 @@ namespace rf {
       assert(costs.valid(p.first));
     }
     init_graph(costs);
+    init_search(search);
 
     for(auto & p : start) {
-      GraphNode * start_node = &graph_nodes[(p.first.x) + (p.first.y)*costs.size().x];
-      heap_decrease(start_node, p.second);
+      seed(search, node_index(p.first), p.second);
     }
   }
   void DijkstraMap::init(const Map<unsigned int> & costs, const Map<Distance> & start) {
     assert(costs.size() == start.size());
     init_graph(costs);
+    init_search(search);
 
-    unsigned int idx = 0;
-    for(unsigned int y = 0 ; y < graph_size.x ; y ++) {
+    for(unsigned int y = 0 ; y < graph_size.y ; y ++) {
       for(unsigned int x = 0 ; x < graph_size.x ; x ++) {
-        GraphNode * node = &graph_nodes[idx];
-        heap_decrease(node, start[Vec2u(x, y)]);
-        idx ++;
+        seed(search, node_index(Vec2u(x, y)), start[Vec2u(x, y)]);
+      }
+    }
+  }
+  void DijkstraMap::seed(Search & s, NodeIndex node, Distance distance) const {
+    if(distance < s.node_distances[node]) {
+      if(use_buckets) {
+        // the bucket queue collects its seeds from node_distances
+        s.node_distances[node] = distance;
+      } else {
+        s.heap_decrease(node, distance);
       }
     }
   }
 
-  DijkstraMap::GraphNode * DijkstraMap::heap_pop() {
+  DijkstraMap::NodeIndex DijkstraMap::Search::heap_pop() {
     assert(heap_size > 0);
-    GraphNode * top = heap_nodes[0];
-    top->heap_node = nullptr;
+    NodeIndex top = heap_nodes[0];
+    node_heap_indices[top] = no_heap_index;
 
     heap_size --;
 
     if(heap_size != 0) {
       // bring last element to top
-      heap_nodes[0] = heap_nodes[heap_size];
-      heap_nodes[0]->heap_node = &heap_nodes[0]; // here lies the rare assertion bug
-      heap_nodes[heap_size] = nullptr;
+      NodeIndex node = heap_nodes[heap_size];
+      Distance distance = node_distances[node];
 
       // percolate it down
       unsigned int index = 0;
 
       while(true) {
-        GraphNode * node = heap_nodes[index];
         unsigned int child_a_index = index*2 + 1;
         unsigned int child_b_index = index*2 + 2;
 
-        if(child_a_index >= heap_size && child_b_index >= heap_size) {
+        // select the smallest child, if any
+        unsigned int child_index;
+        if(child_a_index >= heap_size) {
           // we have reached a leaf
           break;
         } else if(child_b_index >= heap_size) {
           // child a is valid, child b is past the end
-          GraphNode * child_a = heap_nodes[child_a_index];
-          if(child_a->distance < node->distance) {
-            // swap in heap
-            std::swap(heap_nodes[index], heap_nodes[child_a_index]);
-            // swap references to heap
-            std::swap(node->heap_node, child_a->heap_node);
-            index = child_a_index;
-            // this particular case can only occur at the bottom of a tree
-            break;
-          } else {
-            // no swap necessary, done swapping
-            break;
-          }
+          child_index = child_a_index;
+        } else if(node_distances[heap_nodes[child_a_index]] <
+                  node_distances[heap_nodes[child_b_index]]) {
+          child_index = child_a_index;
         } else {
-          // both are valid
-          GraphNode * child_a = heap_nodes[child_a_index];
-          GraphNode * child_b = heap_nodes[child_b_index];
-
-          // check if either child has a smaller value
-          if(child_a->distance < node->distance || child_b->distance < node->distance) {
-            // swap with the smallest child
-            if(child_a->distance < child_b->distance) {
-              // swap in heap
-              std::swap(heap_nodes[index], heap_nodes[child_a_index]);
-              // swap references to heap
-              std::swap(node->heap_node, child_a->heap_node);
-              index = child_a_index;
-            } else {
-              // swap in heap
-              std::swap(heap_nodes[index], heap_nodes[child_b_index]);
-              // swap references to heap
-              std::swap(node->heap_node, child_b->heap_node);
-              index = child_b_index;
-            }
-          } else {
-            // neither child is smaller, so we're done swapping
-            break;
-          }
+          child_index = child_b_index;
+        }
+
+        NodeIndex child = heap_nodes[child_index];
+        if(node_distances[child] < distance) {
+          // move child up into the hole
+          heap_nodes[index] = child;
+          node_heap_indices[child] = index;
+          index = child_index;
+        } else {
+          // neither child is smaller, so we're done swapping
+          break;
         }
       }
+
+      heap_nodes[index] = node;
+      node_heap_indices[node] = index;
     }
 
     return top;
   }
-  void DijkstraMap::heap_decrease(GraphNode * node, Distance new_distance) {
+  void DijkstraMap::Search::heap_decrease(NodeIndex node, Distance new_distance) {
     // the value must decrease
-    assert(new_distance <= node->distance);
-
-    assert(node);
-    assert(node->heap_node);
+    assert(new_distance <= node_distances[node]);
 
     // determine index of node
-    unsigned int index = node->heap_node - heap_nodes;
+    unsigned int index = node_heap_indices[node];
 
-    assert(index >= 0);
+    assert(index != no_heap_index);
     assert(index < heap_size);
 
     // update value
-    node->distance = new_distance;
+    node_distances[node] = new_distance;
 
     // heap is possibly invalid, percolate up
     while(index != 0) {
       unsigned int parent_index = (index - 1)/2;
-
-      // compare with parent
-      //GraphNode * node = heap_nodes[index]; // this will never actually change
-      GraphNode * parent = heap_nodes[parent_index];
-
-      //printf("index: %u\n", index);
-      //printf("parent_index: %u\n", parent_index);
-      //printf("d(index): %u\n", node->distance);
-      //printf("d(parent_index): %u\n", parent->distance);
+      NodeIndex parent = heap_nodes[parent_index];
 
       // swap if smaller
-      if(node->distance < parent->distance) {
-        // swap in heap
-        std::swap(heap_nodes[index], heap_nodes[parent_index]);
-        // swap references to heap
-        std::swap(node->heap_node, parent->heap_node);
+      if(new_distance < node_distances[parent]) {
+        // move parent down into the hole
+        heap_nodes[index] = parent;
+        node_heap_indices[parent] = index;
 
-        // continue with parent_index (now our same node)
+        // continue with parent_index
         index = parent_index;
       } else {
         // no more swapping
         break;
       }
     }
+
+    heap_nodes[index] = node;
+    node_heap_indices[node] = index;
   }
 
   void DijkstraMap::do_dijkstra(Map<Distance> & distances) {
-    while(heap_size > 0) {
-      GraphNode * closest_node = heap_pop();
+    do_dijkstra(search, distances);
+  }
+  void DijkstraMap::do_dijkstra(Map<Distance> & distances, Distance max_distance) {
+    if(use_buckets) {
+      do_dijkstra_buckets(search, max_distance, 0);
+    } else {
+      do_dijkstra_heap(search, max_distance, 0);
+    }
 
-      for(int i = 0 ; i < 8 ; i ++) {
-        GraphNode * neighbor = closest_node->neighbors[i];
+    copy_settled(search, distances, max_distance);
+  }
+  void DijkstraMap::do_dijkstra(Map<Distance> & distances, const std::vector<Vec2u> & queries) {
+    auto & flags = search.node_query_flags;
+    if(flags.size() < node_costs.size()) {
+      flags.resize(node_costs.size(), 0);
+    }
 
-        if(neighbor && neighbor->heap_node != nullptr) {
-          Distance possible_distance = closest_node->distance + neighbor->cost;
+    size_t query_num = 0;
+    for(auto & p : queries) {
+      assert(graph_size.x > p.x && graph_size.y > p.y);
+      NodeIndex node = node_index(p);
+      if(!flags[node]) {
+        flags[node] = 1;
+        query_num ++;
+      }
+    }
 
-          // possible_distance >= closest_node->distance verifies that 
-          // the result did not wrap around
-          if(possible_distance >= closest_node->distance &&
-             possible_distance < neighbor->distance) {
-            heap_decrease(neighbor, possible_distance);
-          }
-        }
+    if(query_num != 0) {
+      if(use_buckets) {
+        do_dijkstra_buckets(search, infinity, query_num);
+      } else {
+        do_dijkstra_heap(search, infinity, query_num);
       }
     }
 
+    for(auto & p : queries) {
+      flags[node_index(p)] = 0;
+    }
+
+    copy_settled(search, distances, infinity);
+  }
+  void DijkstraMap::do_dijkstra(Search & s, Map<Distance> & distances) const {
+    if(use_buckets) {
+      do_dijkstra_buckets(s, infinity, 0);
+    } else {
+      do_dijkstra_heap(s, infinity, 0);
+    }
+
     distances.resize(graph_size);
 
-    unsigned int idx = 0;
     for(unsigned int y = 0 ; y < graph_size.y ; y ++) {
+      auto row = s.node_distances.begin() + node_index(Vec2u(0, y));
+      std::copy(row, row + graph_size.x, distances.data() + y*graph_size.x);
+    }
+  }
+  void DijkstraMap::copy_settled(const Search & s, Map<Distance> & distances, Distance max_distance) const {
+    distances.resize(graph_size);
+
+    for(unsigned int y = 0 ; y < graph_size.y ; y ++) {
+      NodeIndex idx = node_index(Vec2u(0, y));
+      Distance * row = distances.data() + y*graph_size.x;
+
       for(unsigned int x = 0 ; x < graph_size.x ; x ++) {
-        auto & node = graph_nodes[idx];
-        distances[Vec2u(x, y)] = node.distance;
+        Distance distance = s.node_distances[idx];
+        bool settled = s.node_heap_indices[idx] == no_heap_index;
+        row[x] = (settled && distance <= max_distance) ? distance : infinity;
         idx ++;
       }
     }
   }
-}
+  void DijkstraMap::do_dijkstra_heap(Search & s, Distance max_distance, size_t query_num) const {
+    while(s.heap_size > 0) {
+      NodeIndex closest_node = s.heap_pop();
+      Distance closest_distance = s.node_distances[closest_node];
+
+      // every remaining node is unreachable, or beyond the limit
+      if(closest_distance == infinity || closest_distance > max_distance) {
+        break;
+      }
+
+      if(query_num && s.node_query_flags[closest_node]) {
+        query_num --;
+        if(query_num == 0) {
+          break;
+        }
+      }
+
+      for(int i = 0 ; i < 8 ; i ++) {
+        NodeIndex neighbor = closest_node + neighbor_steps[i];
+
+        // the border is never in the heap
+        if(s.node_heap_indices[neighbor] != no_heap_index) {
+          Distance possible_distance = relax(closest_distance, node_costs[neighbor]);
+
+          if(possible_distance < s.node_distances[neighbor]) {
+            s.heap_decrease(neighbor, possible_distance);
+          }
+        }
+      }
+    }
+
+    s.heap_size = 0;
+  }
+  void DijkstraMap::do_dijkstra_buckets(Search & s, Distance max_distance, size_t query_num) const {
+    // Dial's algorithm: every queued distance lies within max_cost of the
+    // current distance, so a ring of max_cost + 1 buckets holds them all.
+    // Nodes are never removed from a bucket; outdated entries are skipped.
+    // The heap built by init_search is ignored, except that each node's heap
+    // index is cleared as it is settled.
+
+    // nodes given an initial distance by init, in order of distance
+    s.bucket_seeds.clear();
+    for(NodeIndex i = 0 ; i < s.node_distances.size() ; i ++) {
+      if(s.node_distances[i] != infinity) {
+        s.bucket_seeds.push_back(std::make_pair(s.node_distances[i], i));
+      }
+    }
+
+    s.heap_size = 0;
+
+    if(s.bucket_seeds.empty()) {
+      return;
+    }
+    std::sort(s.bucket_seeds.begin(), s.bucket_seeds.end());
+
+    unsigned int bucket_num = max_cost + 1;
+    if(s.buckets.size() < bucket_num) {
+      s.buckets.resize(bucket_num);
+    }
 
+    // distances may be negative, so buckets are indexed relative to the
+    // smallest seed
+    Distance base = s.bucket_seeds[0].first;
+    auto bucket_index = [base, bucket_num](Distance distance) {
+      return ((unsigned int)distance - (unsigned int)base) % bucket_num;
+    };
+
+    size_t queued = 0;
+    size_t seed_idx = 0;
+    Distance distance = base;
+
+    bool done = false;
+
+    while(!done && (queued > 0 || seed_idx < s.bucket_seeds.size())) {
+      if(queued == 0) {
+        // nothing left in the ring, skip ahead to the next seed
+        distance = s.bucket_seeds[seed_idx].first;
+      }
+
+      if(distance > max_distance) {
+        break;
+      }
+
+      auto & bucket = s.buckets[bucket_index(distance)];
+
+      while(seed_idx < s.bucket_seeds.size() &&
+            s.bucket_seeds[seed_idx].first == distance) {
+        bucket.push_back(s.bucket_seeds[seed_idx].second);
+        queued ++;
+        seed_idx ++;
+      }
+
+      // zero-cost neighbors are appended to this same bucket
+      for(size_t i = 0 ; i < bucket.size() ; i ++) {
+        NodeIndex node = bucket[i];
+        queued --;
+
+        if(s.node_heap_indices[node] == no_heap_index ||
+           s.node_distances[node] != distance) {
+          continue;
+        }
+        s.node_heap_indices[node] = no_heap_index;
+
+        if(query_num && s.node_query_flags[node]) {
+          query_num --;
+          if(query_num == 0) {
+            done = true;
+            break;
+          }
+        }
+
+        for(int k = 0 ; k < 8 ; k ++) {
+          NodeIndex neighbor = node + neighbor_steps[k];
+          unsigned int cost = node_costs[neighbor];
+
+          // impassable neighbors (and the border) are never queued
+          if(cost != impassable && s.node_heap_indices[neighbor] != no_heap_index) {
+            Distance possible_distance = relax(distance, cost);
+
+            if(possible_distance < s.node_distances[neighbor]) {
+              s.node_distances[neighbor] = possible_distance;
+              s.buckets[bucket_index(possible_distance)].push_back(neighbor);
+              queued ++;
+            }
+          }
+        }
+      }
+      bucket.clear();
+
+      distance ++;
+    }
+
+    // leave the ring empty for the next search
+    if(done || queued > 0) {
+      for(auto & bucket : s.buckets) {
+        bucket.clear();
+      }
+    }
+  }
+
+  void DijkstraMap::do_repair(Map<Distance> & distances,
+                              const Map<unsigned int> & costs,
+                              const std::vector<Goal> & start,
+                              const std::vector<Vec2u> & changed) {
+    Vec2u size = costs.size();
+    assert(distances.size() == size);
+
+    if(repair_goals.size() != size) {
+      repair_goals.resize(size);
+      repair_goals.fill(infinity);
+      repair_mask.resize(size);
+      repair_mask.fill(0);
+    }
+
+    for(auto & p : start) {
+      assert(costs.valid(p.first));
+      auto & goal = repair_goals[p.first];
+      if(p.second < goal) {
+        goal = p.second;
+      }
+    }
+
+    // collect every cell whose distance may have been derived from a changed
+    // cell; this may overestimate the affected region, but never misses any
+    repair_stack.clear();
+    for(auto & p : changed) {
+      assert(costs.valid(p));
+      if(!repair_mask[p]) {
+        repair_mask[p] = 1;
+        repair_stack.push_back(p);
+      }
+    }
+    for(size_t i = 0 ; i < repair_stack.size() ; i ++) {
+      Vec2u p = repair_stack[i];
+      Distance distance = distances[p];
+
+      if(distance == infinity) { continue; }
+
+      for(int k = 0 ; k < 8 ; k ++) {
+        Vec2u q = Vec2i(p) + neighbor_offsets[k];
+
+        if(!costs.valid(q) || repair_mask[q]) { continue; }
+
+        Distance q_distance = distances[q];
+
+        // unreached cells, and goals at their own distance, cannot depend on p
+        if(q_distance == infinity) { continue; }
+        if(q_distance == repair_goals[q]) { continue; }
+
+        if(relax(distance, costs[q]) == q_distance) {
+          repair_mask[q] = 1;
+          repair_stack.push_back(q);
+        }
+      }
+    }
+
+    // reset the affected region to its goal distances, then pull in distances
+    // from neighbors
+    for(auto & p : repair_stack) {
+      distances[p] = repair_goals[p];
+    }
+
+    typedef std::pair<Distance, unsigned int> OpenNode;
+    std::priority_queue<OpenNode, std::vector<OpenNode>, std::greater<OpenNode>> open;
+
+    for(auto & p : repair_stack) {
+      Distance distance = distances[p];
+
+      for(int k = 0 ; k < 8 ; k ++) {
+        Vec2u q = Vec2i(p) + neighbor_offsets[k];
+        if(costs.valid(q)) {
+          Distance possible_distance = relax(distances[q], costs[p]);
+          if(possible_distance < distance) {
+            distance = possible_distance;
+          }
+        }
+      }
+
+      distances[p] = distance;
+      if(distance != infinity) {
+        open.push(OpenNode(distance, costs.index(p)));
+      }
+    }
+
+    // propagate decreased distances outward
+    while(!open.empty()) {
+      OpenNode top = open.top();
+      open.pop();
+
+      Vec2u p(top.second % size.x, top.second / size.x);
+
+      // skip stale entries
+      if(top.first != distances[p]) { continue; }
+
+      for(int k = 0 ; k < 8 ; k ++) {
+        Vec2u q = Vec2i(p) + neighbor_offsets[k];
+        if(costs.valid(q)) {
+          Distance possible_distance = relax(top.first, costs[q]);
+          if(possible_distance < distances[q]) {
+            distances[q] = possible_distance;
+            open.push(OpenNode(possible_distance, costs.index(q)));
+          }
+        }
+      }
+    }
+
+    // clean up scratch space
+    for(auto & p : repair_stack) {
+      repair_mask[p] = 0;
+    }
+    for(auto & p : start) {
+      repair_goals[p.first] = infinity;
+    }
+  }
+}
@@ -2,22 +2,37 @@
 #define RF_UTIL_DIJKSTRA_HPP
 
 #include <cstddef>
+#include <cstdint>
 #include <limits>
+#include <vector>
 
 #include <rf/util/Vec2.hpp>
 #include <rf/util/Map.hpp>
 
 namespace rf {
+  class ThreadPool;
+
   struct DijkstraMap {
     public:
     typedef int Distance;
     static constexpr Distance infinity = std::numeric_limits<Distance>::max();
     typedef std::pair<Vec2u, int> Goal;
 
+    // cost of a cell which can never be entered
+    static constexpr unsigned int impassable = std::numeric_limits<unsigned int>::max();
+    // largest cost for which the BUCKET queue is used
+    static constexpr unsigned int max_bucket_cost = 64;
+
+    // HEAP works with any costs; BUCKET keeps one bucket per distance, and
+    // is used only when no passable cost exceeds max_bucket_cost
+    enum QueueMode { HEAP, BUCKET };
+
     DijkstraMap() = default;
     DijkstraMap(const DijkstraMap & other) = delete;
     DijkstraMap & operator=(const DijkstraMap & other) = delete;
-    ~DijkstraMap();
+
+    void set_queue_mode(QueueMode mode) { _queue_mode = mode; }
+    QueueMode queue_mode() const { return _queue_mode; }
 
     void compute(Map<Distance> & distances,
                  const Map<unsigned int> & costs,
@@ -53,40 +68,150 @@ namespace rf {
       return distances;
     }
 
+    // As above, but the search stops at cells farther than `max_distance`.
+    // Every cell not settled by then is set to infinity.
+    void compute(Map<Distance> & distances,
+                 const Map<unsigned int> & costs,
+                 Vec2u start,
+                 Distance max_distance);
+    void compute(Map<Distance> & distances,
+                 const Map<unsigned int> & costs,
+                 const std::vector<Vec2u> & start,
+                 Distance max_distance);
+    void compute(Map<Distance> & distances,
+                 const Map<unsigned int> & costs,
+                 const std::vector<Goal> & start,
+                 Distance max_distance);
+
+    // As above, but the search stops as soon as every cell in `queries` has
+    // its final distance. Every cell not settled by then is set to infinity.
+    void compute(Map<Distance> & distances,
+                 const Map<unsigned int> & costs,
+                 Vec2u start,
+                 const std::vector<Vec2u> & queries);
+    void compute(Map<Distance> & distances,
+                 const Map<unsigned int> & costs,
+                 const std::vector<Vec2u> & start,
+                 const std::vector<Vec2u> & queries);
+    void compute(Map<Distance> & distances,
+                 const Map<unsigned int> & costs,
+                 const std::vector<Goal> & start,
+                 const std::vector<Vec2u> & queries);
+
+    // Computes one distance map per goal set in `starts`, all over the same
+    // costs. The graph is loaded once and shared by every search; given a
+    // thread pool, the searches are spread across its workers.
+    void compute_batch(std::vector<Map<Distance>> & distances,
+                       const Map<unsigned int> & costs,
+                       const std::vector<std::vector<Goal>> & starts,
+                       ThreadPool * pool = nullptr);
+
+    // Repairs `distances`, the result of a previous compute over the same
+    // graph, after the costs and/or goals of the cells in `changed` have been
+    // modified. Cells whose cost changed, as well as old and new goal cells,
+    // must all be listed. Only the affected region is recomputed, and the
+    // result is identical to a full compute with the new costs and goals.
+    void update(Map<Distance> & distances,
+                const Map<unsigned int> & costs,
+                Vec2u start,
+                const std::vector<Vec2u> & changed);
+    void update(Map<Distance> & distances,
+                const Map<unsigned int> & costs,
+                const std::vector<Vec2u> & start,
+                const std::vector<Vec2u> & changed);
+    void update(Map<Distance> & distances,
+                const Map<unsigned int> & costs,
+                const std::vector<Goal> & start,
+                const std::vector<Vec2u> & changed);
+
+    // bytes of graph and queue storage currently allocated
+    size_t memory_usage() const;
+
     static void test_heap();
+    static void test_buckets();
+    static void test_batch();
+    static void test_bounded();
+    static void test_update();
     static void test();
 
     private:
-    struct GraphNode;
-    typedef GraphNode * HeapNode;
-    struct GraphNode {
-      // connectivity with neighboring cells
-      GraphNode * neighbors[8] = {
-        nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr
-      };
+    typedef uint32_t NodeIndex;
+    // heap index of nodes which are not in the heap (border and settled nodes)
+    static constexpr uint32_t no_heap_index = std::numeric_limits<uint32_t>::max();
+
+    // The graph is stored as flat arrays covering the cost map plus a one
+    // cell border of impassable, settled nodes, so that the neighbors of any
+    // interior node are found by adding one of `neighbor_steps` to its index.
+    Vec2u graph_size;
+    unsigned int graph_stride = 0;
+    int neighbor_steps[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    // cost to enter each node
+    std::vector<unsigned int> node_costs;
+    // largest cost, not counting impassable cells
+    unsigned int max_cost = 0;
+
+    QueueMode _queue_mode = HEAP;
+    // whether the current graph is searched using buckets rather than the heap
+    bool use_buckets = false;
+
+    // per-search state; the graph above may be shared by several searches
+    struct Search {
       // determines heap order; should not be set directly
-      Distance distance = 0;
-      // cost to enter this cell
-      unsigned int cost = 0;
-      // pointer to location in heap
-      HeapNode * heap_node = nullptr;
+      std::vector<Distance> node_distances;
+      // location of each node in the heap
+      std::vector<uint32_t> node_heap_indices;
+
+      std::vector<NodeIndex> heap_nodes;
+      size_t heap_size = 0;
+
+      std::vector<std::pair<Distance, NodeIndex>> bucket_seeds;
+      std::vector<std::vector<NodeIndex>> buckets;
+
+      // nonzero for nodes which must be settled before a query-limited
+      // search stops; cleared once the search is done
+      std::vector<unsigned char> node_query_flags;
+
+      NodeIndex heap_pop();
+      void heap_decrease(NodeIndex node, Distance distance);
+
+      size_t memory_usage() const;
     };
 
-    GraphNode * graph_nodes = nullptr;
-    HeapNode * heap_nodes = nullptr;
-    Vec2u graph_size;
-    size_t heap_size = 0;
+    Search search;
+    std::vector<Search> batch_searches;
+
+    NodeIndex node_index(Vec2u pos) const {
+      return (pos.x + 1) + (pos.y + 1)*graph_stride;
+    }
 
     void init_graph(const Map<unsigned int> & costs);
     void init(const Map<unsigned int> & costs, Vec2u start);
     void init(const Map<unsigned int> & costs, const std::vector<Vec2u> & start);
     void init(const Map<unsigned int> & costs, const std::vector<Goal> & start);
     void init(const Map<unsigned int> & costs, const Map<Distance> & start);
-
-    GraphNode * heap_pop();
-    void heap_decrease(GraphNode * node, Distance distance);
+    void init_search(Search & s) const;
+    void seed(Search & s, NodeIndex node, Distance distance) const;
 
     void do_dijkstra(Map<Distance> & distances);
+    void do_dijkstra(Map<Distance> & distances, Distance max_distance);
+    void do_dijkstra(Map<Distance> & distances, const std::vector<Vec2u> & queries);
+    void do_dijkstra(Search & s, Map<Distance> & distances) const;
+    // `query_num` counts the flagged nodes left to settle, or is 0 when the
+    // search is not query-limited
+    void do_dijkstra_heap(Search & s, Distance max_distance, size_t query_num) const;
+    void do_dijkstra_buckets(Search & s, Distance max_distance, size_t query_num) const;
+    void copy_settled(const Search & s, Map<Distance> & distances, Distance max_distance) const;
+
+    // scratch space for update(...)
+    Map<Distance> repair_goals;
+    Map<unsigned char> repair_mask;
+    std::vector<Vec2u> repair_stack;
+
+    void do_repair(Map<Distance> & distances,
+                   const Map<unsigned int> & costs,
+                   const std::vector<Goal> & start,
+                   const std::vector<Vec2u> & changed);
   };
 }
 
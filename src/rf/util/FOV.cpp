@@ -1,42 +1,67 @@
 
 #include "FOV.hpp"
 
+#include <cassert>
+#include <random>
+
 namespace rf {
+  void FOV::sample_into(BitGrid & out, const Rect2i & rect) const {
+    out.resize(Vec2u(rect.size));
+    for(int j = 0 ; j < rect.size.y ; j ++) {
+      for(int i = 0 ; i < rect.size.x ; i ++) {
+        if(is_visible(rect.pos + Vec2i(i, j))) {
+          out.set(Vec2u(i, j));
+        }
+      }
+    }
+  }
   std::vector<Vec2i> FOV::sample_sparse(const Rect2i & rect) const {
-    int xstart = rect.pos.x;
-    int ystart = rect.pos.y;
-    int xend = rect.pos.x + rect.size.x;
-    int yend = rect.pos.y + rect.size.y;
+    BitGrid grid;
+    sample_into(grid, rect);
 
     std::vector<Vec2i> result;
-    for(int y = ystart ; y < yend ; y ++) {
-      for(int x = xstart ; x < xend ; x ++) {
-        Vec2i pos(x, y);
-        if(is_visible(pos)) {
-          result.push_back(pos);
+    for(int j = 0 ; j < rect.size.y ; j ++) {
+      for(int i = 0 ; i < rect.size.x ; i ++) {
+        if(grid.get(Vec2u(i, j))) {
+          result.push_back(rect.pos + Vec2i(i, j));
         }
       }
     }
     return result;
   }
   std::vector<bool> FOV::sample(const Rect2i & rect) const {
-    int xstart = rect.pos.x;
-    int ystart = rect.pos.y;
-    int xend = rect.pos.x + rect.size.x;
-    int yend = rect.pos.y + rect.size.y;
+    BitGrid grid;
+    sample_into(grid, rect);
 
     std::vector<bool> result(rect.size.x * rect.size.y);
-
-    for(int y = ystart ; y < yend ; y ++) {
-      for(int x = xstart ; x < xend ; x ++) {
-        Vec2i pos(x, y);
-        result[x + y * rect.size.x] = is_visible(pos);
+    for(int j = 0 ; j < rect.size.y ; j ++) {
+      for(int i = 0 ; i < rect.size.x ; i ++) {
+        result[i + j * rect.size.x] = grid.get(Vec2u(i, j));
       }
     }
-
     return result;
   }
 
+  void GlobalFOV::sample_into(BitGrid & out, const Rect2i & rect) const {
+    out.resize(Vec2u(rect.size));
+    out.fill(true);
+  }
+
+  void GridFOV::sample_into(BitGrid & out, const Rect2i & rect) const {
+    visible.copy_rect(out, Rect2i(rect.pos - _origin, rect.size));
+  }
+  void GridFOV::reset(Vec2i p, unsigned int r) {
+    _width = r*2 + 1;
+    _radius = r;
+    _origin = p - Vec2i(r, r);
+
+    if(visible.size() != Vec2u(_width, _width)) {
+      visible.resize(Vec2u(_width, _width));
+    } else {
+      visible.clear();
+    }
+  }
+
   static float diagonal_len(Vec2i ray) {
     const float D = 1.0f;
     const float D2 = 1.414f;
@@ -49,7 +74,7 @@ namespace rf {
     int j = 0, e = 0;
 
     for(int i = 0 ; i <= ray.x ; i ++) {
-      values[_radius + i + (_radius + j)*_width] = visible_value;
+      set_visible(_radius + i, _radius + j);
 
       Vec2i q = p + Vec2i(i, j);
       if(!solid_map.valid(q) || solid_map[q] == 1) { return; }
@@ -67,7 +92,7 @@ namespace rf {
     int j = 0, e = 0;
 
     for(int i = 0 ; i <= ray.x ; i ++) {
-      values[_radius + j + (_radius + i)*_width] = visible_value;
+      set_visible(_radius + j, _radius + i);
 
       Vec2i q = p + Vec2i(j, i);
       if(!solid_map.valid(q) || solid_map[q] == 1) { return; }
@@ -85,7 +110,7 @@ namespace rf {
     int j = 0, e = 0;
 
     for(int i = 0 ; i <= ray.x ; i ++) {
-      values[_radius - j + (_radius + i)*_width] = visible_value;
+      set_visible(_radius - j, _radius + i);
 
       Vec2i q = p + Vec2i(-j, i);
       if(!solid_map.valid(q) || solid_map[q] == 1) { return; }
@@ -103,7 +128,7 @@ namespace rf {
     int j = 0, e = 0;
 
     for(int i = 0 ; i <= ray.x ; i ++) {
-      values[_radius - i + (_radius + j)*_width] = visible_value;
+      set_visible(_radius - i, _radius + j);
 
       Vec2i q = p + Vec2i(-i, j);
       if(!solid_map.valid(q) || solid_map[q] == 1) { return; }
@@ -121,7 +146,7 @@ namespace rf {
     int j = 0, e = 0;
 
     for(int i = 0 ; i <= ray.x ; i ++) {
-      values[_radius - i + (_radius - j)*_width] = visible_value;
+      set_visible(_radius - i, _radius - j);
 
       Vec2i q = p + Vec2i(-i, -j);
       if(!solid_map.valid(q) || solid_map[q] == 1) { return; }
@@ -139,7 +164,7 @@ namespace rf {
     int j = 0, e = 0;
 
     for(int i = 0 ; i <= ray.x ; i ++) {
-      values[_radius - j + (_radius - i)*_width] = visible_value;
+      set_visible(_radius - j, _radius - i);
 
       Vec2i q = p + Vec2i(-j, -i);
       if(!solid_map.valid(q) || solid_map[q] == 1) { return; }
@@ -157,7 +182,7 @@ namespace rf {
     int j = 0, e = 0;
 
     for(int i = 0 ; i <= ray.x ; i ++) {
-      values[_radius + j + (_radius - i)*_width] = visible_value;
+      set_visible(_radius + j, _radius - i);
 
       Vec2i q = p + Vec2i(j, -i);
       if(!solid_map.valid(q) || solid_map[q] == 1) { return; }
@@ -175,7 +200,7 @@ namespace rf {
     int j = 0, e = 0;
 
     for(int i = 0 ; i <= ray.x ; i ++) {
-      values[_radius + i + (_radius - j)*_width] = visible_value;
+      set_visible(_radius + i, _radius - j);
 
       Vec2i q = p + Vec2i(i, -j);
       if(!solid_map.valid(q) || solid_map[q] == 1) { return; }
@@ -192,16 +217,15 @@ namespace rf {
 
 
   void BresenhamFOV::update(const Map<unsigned int> & solid_map, Vec2i p, unsigned int r) {
-    _width = r*2 + 1;
-    _radius = r;
-    _origin = p - Vec2i(r, r);
-
-    if(values.size() != _width * _width) {
-      values.resize(_width * _width, visible_value);
+    if(ray_table.radius() != r) {
+      ray_table = RayTable(r);
     }
-    visible_value ++;
+    update(ray_table, solid_map, p);
+  }
+  void BresenhamFOV::update_stepwise(const Map<unsigned int> & solid_map, Vec2i p, unsigned int r) {
+    reset(p, r);
 
-    for(int y = 0 ; y <= r ; y ++) {
+    for(int y = 0 ; y <= (int)r ; y ++) {
       int x = r;
       raycast_o0(solid_map, p, Vec2i(x, y));
       raycast_o1(solid_map, p, Vec2i(x, y));
@@ -214,17 +238,238 @@ namespace rf {
     }
   }
 
-  bool BresenhamFOV::is_visible(Vec2i pos) const {
-    int i = pos.x - _origin.x;
-    int j = pos.y - _origin.y;
+  void BresenhamFOV::update(const RayTable & rays, const Map<unsigned int> & solid_map, Vec2i p) {
+    reset(p, rays.radius());
 
-    if(i < 0) { return false; }
-    if(i >= _width) { return false; }
+    auto & cells = rays.cells();
+    int r = _radius;
 
-    if(j < 0) { return false; }
-    if(j >= _width) { return false; }
+    Vec2u size = solid_map.size();
+    if(p.x >= r && p.y >= r && p.x + r < (int)size.x && p.y + r < (int)size.y) {
+      // every cell is on the map, so rows are a fixed stride apart
+      const unsigned int * center = solid_map.data() + solid_map.index(Vec2u(p));
+      int stride = size.x;
 
-    return values[i + j * _width] == visible_value;
+      size_t k = 0;
+      while(k < cells.size()) {
+        auto & cell = cells[k];
+        set_visible(r + cell.dx, r + cell.dy);
+        k = (center[cell.dx + cell.dy*stride] == 1) ? cell.next : k + 1;
+      }
+    } else {
+      size_t k = 0;
+      while(k < cells.size()) {
+        auto & cell = cells[k];
+        set_visible(r + cell.dx, r + cell.dy);
+
+        Vec2i q = p + Vec2i(cell.dx, cell.dy);
+        k = (!solid_map.valid(q) || solid_map[q] == 1) ? cell.next : k + 1;
+      }
+    }
   }
-}
 
+  RayTable::RayTable(unsigned int radius)
+    : _radius(radius) {
+    struct Node {
+      Vec2i offset;
+      std::vector<unsigned int> children;
+    };
+    std::vector<Node> tree(1);
+
+    // the same rays as BresenhamFOV::raycast_o0..o7, mapped into each octant
+    static const int octants[8][4] = {
+      {  1,  0,  0,  1 },
+      {  0,  1,  1,  0 },
+      {  0, -1,  1,  0 },
+      { -1,  0,  0,  1 },
+      { -1,  0,  0, -1 },
+      {  0, -1, -1,  0 },
+      {  0,  1, -1,  0 },
+      {  1,  0,  0, -1 },
+    };
+
+    int r = radius;
+    for(auto & o : octants) {
+      for(int y = 0 ; y <= r ; y ++) {
+        Vec2i ray(r, y);
+        unsigned int node = 0;
+        int j = 0, e = 0;
+
+        for(int i = 0 ; i <= ray.x ; i ++) {
+          Vec2i offset(i*o[0] + j*o[1], i*o[2] + j*o[3]);
+
+          // the origin is the root; every other cell is a child of the last
+          if(i > 0) {
+            unsigned int child = 0;
+            for(auto c : tree[node].children) {
+              if(tree[c].offset == offset) { child = c; break; }
+            }
+            if(child == 0) {
+              child = tree.size();
+              tree[node].children.push_back(child);
+              tree.emplace_back();
+              tree.back().offset = offset;
+            }
+            node = child;
+          }
+
+          if(diagonal_len(Vec2i(i, j)) > r) { break; }
+
+          e += ray.y;
+          if(2*e >= ray.x) {
+            j ++;
+            e -= ray.x;
+          }
+        }
+      }
+    }
+
+    // flatten in depth-first order, filling in `next` on the way back up
+    struct Visit {
+      unsigned int node;
+      unsigned int cell;
+      unsigned int child;
+    };
+    std::vector<Visit> stack;
+
+    _cells.reserve(tree.size());
+    _cells.push_back(Cell{ 0, 0, 0 });
+    stack.push_back(Visit{ 0, 0, 0 });
+
+    while(!stack.empty()) {
+      Visit & top = stack.back();
+      auto & children = tree[top.node].children;
+
+      if(top.child < children.size()) {
+        unsigned int child = children[top.child ++];
+        Vec2i offset = tree[child].offset;
+        stack.push_back(Visit{ child, (unsigned int)_cells.size(), 0 });
+        _cells.push_back(Cell{ (int16_t)offset.x, (int16_t)offset.y, 0 });
+      } else {
+        _cells[top.cell].next = _cells.size();
+        stack.pop_back();
+      }
+    }
+  }
+
+  // BresenhamFOV lights the cell after the last one within diagonal_len of
+  // the origin, so this accepts a cell when the cell one step closer along
+  // its major axis is within the radius (in integers)
+  static bool within_radius(int dx, int dy, int r) {
+    int ax = std::abs(dx);
+    int ay = std::abs(dy);
+    return 1000*(std::max(ax, ay) - 1) + 414*std::min(ax, ay) <= 1000*r;
+  }
+
+  void ShadowcastFOV::cast_light(const Map<unsigned int> & solid_map,
+                                 Vec2i p,
+                                 int row,
+                                 float start_slope,
+                                 float end_slope,
+                                 int xx, int xy, int yx, int yy) {
+    if(start_slope < end_slope) { return; }
+
+    int r = _radius;
+    float next_start_slope = start_slope;
+
+    for(int j = row ; j <= r ; j ++) {
+      bool blocked = false;
+      int dy = -j;
+
+      for(int dx = -j ; dx <= 0 ; dx ++) {
+        // slopes through the far corners of this cell
+        float l_slope = (dx - 0.5f) / (dy + 0.5f);
+        float r_slope = (dx + 0.5f) / (dy - 0.5f);
+
+        if(start_slope < r_slope) { continue; }
+        if(end_slope > l_slope) { break; }
+
+        int i = dx*xx + dy*xy;
+        int k = dx*yx + dy*yy;
+        Vec2i q = p + Vec2i(i, k);
+
+        if(within_radius(dx, dy, r)) {
+          set_visible(_radius + i, _radius + k);
+        }
+
+        bool solid = !solid_map.valid(q) || solid_map[q] == 1;
+
+        if(blocked) {
+          if(solid) {
+            next_start_slope = r_slope;
+          } else {
+            blocked = false;
+            start_slope = next_start_slope;
+          }
+        } else if(solid && j < r) {
+          // light the rows beyond up to this cell, then continue past it
+          blocked = true;
+          cast_light(solid_map, p, j + 1, start_slope, l_slope, xx, xy, yx, yy);
+          next_start_slope = r_slope;
+        }
+      }
+
+      if(blocked) { break; }
+    }
+  }
+
+  void ShadowcastFOV::update(const Map<unsigned int> & solid_map, Vec2i p, unsigned int r) {
+    reset(p, r);
+
+    set_visible(_radius, _radius);
+
+    static const int octants[8][4] = {
+      {  1,  0,  0,  1 },
+      {  0,  1,  1,  0 },
+      {  0, -1,  1,  0 },
+      { -1,  0,  0,  1 },
+      { -1,  0,  0, -1 },
+      {  0, -1, -1,  0 },
+      {  0,  1, -1,  0 },
+      {  1,  0,  0, -1 },
+    };
+
+    for(auto & o : octants) {
+      cast_light(solid_map, p, 1, 1.0f, 0.0f, o[0], o[1], o[2], o[3]);
+    }
+  }
+
+  void BresenhamFOV::test() {
+    std::mt19937 gen(15);
+
+    BresenhamFOV table_fov;
+    BresenhamFOV stepwise_fov;
+    BitGrid table_bits;
+    BitGrid stepwise_bits;
+
+    for(int i = 0 ; i < 40 ; i ++) {
+      Vec2u size(1 + gen() % 50, 1 + gen() % 50);
+
+      Map<unsigned int> solid_map(size);
+      for(unsigned int y = 0 ; y < size.y ; y ++) {
+        for(unsigned int x = 0 ; x < size.x ; x ++) {
+          solid_map[Vec2u(x, y)] = gen() % 4 == 0;
+        }
+      }
+
+      // origins near and past the edges, so both walks are covered
+      for(int j = 0 ; j < 20 ; j ++) {
+        Vec2i p = Vec2i(gen() % (size.x + 10), gen() % (size.y + 10)) - Vec2i(5, 5);
+        unsigned int r = gen() % 24;
+
+        table_fov.update(solid_map, p, r);
+        stepwise_fov.update_stepwise(solid_map, p, r);
+
+        Rect2i rect(p - Vec2i(r + 2, r + 2), Vec2i(2*r + 5, 2*r + 5));
+        table_fov.sample_into(table_bits, rect);
+        stepwise_fov.sample_into(stepwise_bits, rect);
+
+        for(int y = 0 ; y < rect.size.y ; y ++) {
+          for(int x = 0 ; x < rect.size.x ; x ++) {
+            assert(table_bits.get(Vec2u(x, y)) == stepwise_bits.get(Vec2u(x, y)));
+          }
+        }
+      }
+    }
+  }
+}
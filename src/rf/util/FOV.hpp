@@ -2,41 +2,129 @@
 #define RF_GAME_FOV_HPP
 
 #include <vector>
+#include <cstdint>
 
 #include <rf/util/Vec2.hpp>
 #include <rf/util/Map.hpp>
+#include <rf/util/BitGrid.hpp>
 
 namespace rf {
   class FOV {
     public:
     virtual bool is_visible(Vec2i pos) const { return false; }
 
+    // Writes the visibility of every cell in `rect` into `out`, resized to
+    // rect.size, with out[p - rect.pos] set for visible p. Subclasses which
+    // store visibility as bits copy it a word at a time.
+    virtual void sample_into(BitGrid & out, const Rect2i & rect) const;
+
     std::vector<Vec2i> sample_sparse(const Rect2i & rect) const;
     std::vector<bool> sample(const Rect2i & rect) const;
+
+    // Calls fn(pos) for every visible cell in `rect`, row by row. This is a
+    // template, so it is chosen by the static type of the FOV: subclasses
+    // hide it with loops that need no virtual call per cell, and this one is
+    // the fallback for callers holding a plain FOV.
+    template<typename Fn>
+    void for_each_visible(const Rect2i & rect, Fn fn) const {
+      for(int j = 0 ; j < rect.size.y ; j ++) {
+        for(int i = 0 ; i < rect.size.x ; i ++) {
+          Vec2i p = rect.pos + Vec2i(i, j);
+          if(is_visible(p)) { fn(p); }
+        }
+      }
+    }
   };
 
-  class GlobalFOV : public FOV {
+  class GlobalFOV final : public FOV {
     public:
     bool is_visible(Vec2i pos) const override { return true; }
+    void sample_into(BitGrid & out, const Rect2i & rect) const override;
+
+    template<typename Fn>
+    void for_each_visible(const Rect2i & rect, Fn fn) const {
+      for(int j = 0 ; j < rect.size.y ; j ++) {
+        for(int i = 0 ; i < rect.size.x ; i ++) {
+          fn(rect.pos + Vec2i(i, j));
+        }
+      }
+    }
   };
 
-  class BresenhamFOV : public FOV {
+  // An FOV which stores visibility as a square of bits around its origin
+  class GridFOV : public FOV {
     public:
-    void update(const Map<unsigned int> & solid_map, Vec2i p, unsigned int r);
+    bool is_visible(Vec2i pos) const override {
+      Vec2i p = pos - _origin;
+      return visible.valid(p) && visible.get(p);
+    }
+    void sample_into(BitGrid & out, const Rect2i & rect) const override;
 
-    bool is_visible(Vec2i pos) const override;
+    template<typename Fn>
+    void for_each_visible(const Rect2i & rect, Fn fn) const {
+      Vec2i origin = _origin;
+      visible.for_each_set(Rect2i(rect.pos - origin, rect.size),
+                           [&](Vec2i p) { fn(p + origin); });
+    }
 
     unsigned int width() const { return _width; }
     unsigned int radius() const { return _radius; }
     Vec2i origin() const { return _origin; }
+    // whether `pos` lies in the square the last update looked over, i.e.
+    // whether a change at `pos` could change what is visible
+    bool covers(Vec2i pos) const { return visible.valid(pos - _origin); }
 
-    private:
+    protected:
     unsigned int _width = 0;
     unsigned int _radius = 0;
     Vec2i _origin;
 
-    std::vector<unsigned int> values;
-    unsigned int visible_value = 0;
+    BitGrid visible;
+
+    // clears the grid for an update around `p`
+    void reset(Vec2i p, unsigned int r);
+    // marks a cell, relative to the top-left corner of the grid
+    void set_visible(int i, int j) { visible.set(Vec2u(i, j)); }
+  };
+
+  // The rays BresenhamFOV casts at one radius, merged into a tree wherever
+  // they start with the same cells, and flattened in depth-first order. Any
+  // cell which blocks sight skips ahead to `next`, past every cell behind
+  // it. Read-only once built, so one table can serve many viewers at once.
+  class RayTable {
+    public:
+    struct Cell {
+      int16_t dx;
+      int16_t dy;
+      // index of the first cell not behind this one
+      uint32_t next;
+    };
+
+    RayTable(unsigned int radius = 0);
+
+    unsigned int radius() const { return _radius; }
+    const std::vector<Cell> & cells() const { return _cells; }
+
+    private:
+    unsigned int _radius;
+    std::vector<Cell> _cells;
+  };
+
+  class BresenhamFOV final : public GridFOV {
+    public:
+    // Walks the RayTable for `r`, which is built on the first update at that
+    // radius and kept until the radius changes.
+    void update(const Map<unsigned int> & solid_map, Vec2i p, unsigned int r);
+    // As above, with the radius of `rays`
+    void update(const RayTable & rays, const Map<unsigned int> & solid_map, Vec2i p);
+    // As above, but stepping along every ray in turn. Much slower; this is
+    // what the tables are built from, and is kept to check them against.
+    void update_stepwise(const Map<unsigned int> & solid_map, Vec2i p, unsigned int r);
+
+    static void test();
+
+    private:
+    RayTable ray_table;
 
     void raycast_o0(const Map<unsigned int> & solid_map, Vec2i p, Vec2i ray);
     void raycast_o1(const Map<unsigned int> & solid_map, Vec2i p, Vec2i ray);
@@ -47,6 +135,42 @@ namespace rf {
     void raycast_o6(const Map<unsigned int> & solid_map, Vec2i p, Vec2i ray);
     void raycast_o7(const Map<unsigned int> & solid_map, Vec2i p, Vec2i ray);
   };
+
+  // Recursive shadowcasting. Each octant is scanned row by row outward from
+  // the origin, and rows are only scanned between the slopes still lit, so a
+  // cell is visited once per octant it lies in instead of once per ray
+  // passing through it. Uses the same solid cells and radius as BresenhamFOV.
+  class ShadowcastFOV final : public GridFOV {
+    public:
+    void update(const Map<unsigned int> & solid_map, Vec2i p, unsigned int r);
+
+    private:
+    void cast_light(const Map<unsigned int> & solid_map,
+                    Vec2i p,
+                    int row,
+                    float start_slope,
+                    float end_slope,
+                    int xx, int xy, int yx, int yy);
+  };
+
+  // As FOV::sample_sparse, but dispatched on the static type of `fov`, so
+  // that the loop over `rect` is inlined for BresenhamFOV, GlobalFOV, etc.
+  template<typename F>
+  std::vector<Vec2i> sample_sparse(const F & fov, const Rect2i & rect) {
+    std::vector<Vec2i> result;
+    fov.for_each_visible(rect, [&](Vec2i p) { result.push_back(p); });
+    return result;
+  }
+  // As FOV::sample, likewise
+  template<typename F>
+  std::vector<bool> sample(const F & fov, const Rect2i & rect) {
+    std::vector<bool> result(rect.size.x * rect.size.y);
+    fov.for_each_visible(rect, [&](Vec2i p) {
+      Vec2i q = p - rect.pos;
+      result[q.x + q.y * rect.size.x] = true;
+    });
+    return result;
+  }
 }
 
 #endif
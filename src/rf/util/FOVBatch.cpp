@@ -0,0 +1,113 @@
+
+#include "FOVBatch.hpp"
+
+#include <cassert>
+#include <random>
+
+namespace rf {
+  const RayTable & FOVBatch::table(unsigned int radius) {
+    if(tables.size() <= radius) {
+      tables.resize(radius + 1);
+    }
+    if(!tables[radius]) {
+      tables[radius].reset(new RayTable(radius));
+    }
+    return *tables[radius];
+  }
+
+  void FOVBatch::compute(const Map<unsigned int> & solid_map,
+                         const std::vector<Viewer> & viewers,
+                         ThreadPool * pool) {
+    // tables are built up front, so that the workers only ever read them
+    for(auto & viewer : viewers) {
+      table(viewer.radius);
+    }
+
+    viewer_num = viewers.size();
+    if(fovs.size() < viewer_num) {
+      fovs.resize(viewer_num);
+    }
+
+    auto task = [this, &solid_map, &viewers](unsigned int i, unsigned int worker) {
+      fovs[i].update(*tables[viewers[i].radius], solid_map, viewers[i].pos);
+    };
+
+    if(pool) {
+      pool->run(viewer_num, task);
+    } else {
+      for(unsigned int i = 0 ; i < viewer_num ; i ++) {
+        task(i, 0);
+      }
+    }
+  }
+
+  void FOVBatch::find_viewers(std::vector<unsigned int> & viewers_out, Vec2i pos) const {
+    viewers_out.clear();
+    for(unsigned int i = 0 ; i < viewer_num ; i ++) {
+      if(fovs[i].is_visible(pos)) {
+        viewers_out.push_back(i);
+      }
+    }
+  }
+
+  void FOVBatch::test() {
+    std::mt19937 gen(14);
+
+    ThreadPool pool(4);
+    FOVBatch serial;
+    FOVBatch pooled;
+    BresenhamFOV expected;
+    std::vector<unsigned int> found;
+
+    for(int i = 0 ; i < 20 ; i ++) {
+      Vec2u size(1 + gen() % 60, 1 + gen() % 60);
+
+      Map<unsigned int> solid_map(size);
+      for(unsigned int y = 0 ; y < size.y ; y ++) {
+        for(unsigned int x = 0 ; x < size.x ; x ++) {
+          solid_map[Vec2u(x, y)] = gen() % 4 == 0;
+        }
+      }
+
+      // viewers may stand in walls, or off the map entirely
+      std::vector<Viewer> viewers(gen() % 40);
+      for(auto & viewer : viewers) {
+        viewer.pos = Vec2i(gen() % (size.x + 10), gen() % (size.y + 10)) - Vec2i(5, 5);
+        viewer.radius = gen() % 20;
+      }
+
+      serial.compute(solid_map, viewers);
+      pooled.compute(solid_map, viewers, &pool);
+      assert(serial.size() == viewers.size());
+      assert(pooled.size() == viewers.size());
+
+      for(unsigned int v = 0 ; v < viewers.size() ; v ++) {
+        expected.update_stepwise(solid_map, viewers[v].pos, viewers[v].radius);
+
+        int r = viewers[v].radius + 2;
+        for(int y = -r ; y <= r ; y ++) {
+          for(int x = -r ; x <= r ; x ++) {
+            Vec2i p = viewers[v].pos + Vec2i(x, y);
+            (void)p;
+            assert(serial.can_see(v, p) == expected.is_visible(p));
+            assert(pooled.can_see(v, p) == expected.is_visible(p));
+          }
+        }
+      }
+
+      for(int j = 0 ; j < 20 ; j ++) {
+        Vec2i p(gen() % size.x, gen() % size.y);
+        pooled.find_viewers(found, p);
+
+        unsigned int k = 0;
+        for(unsigned int v = 0 ; v < viewers.size() ; v ++) {
+          if(serial.can_see(v, p)) {
+            assert(k < found.size() && found[k] == v);
+            k ++;
+          }
+        }
+        assert(k == found.size());
+      }
+    }
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef RF_UTIL_FOVBATCH_HPP
+#define RF_UTIL_FOVBATCH_HPP
+
+#include <vector>
+#include <memory>
+
+#include <rf/util/Vec2.hpp>
+#include <rf/util/Map.hpp>
+#include <rf/util/FOV.hpp>
+#include <rf/util/ThreadPool.hpp>
+
+namespace rf {
+  // Computes the BresenhamFOV of many viewers over one solid map, such as
+  // every monster on a level at once. Viewers with the same radius walk the
+  // same RayTable, which is built once and kept for later batches, and the
+  // viewers are split across a ThreadPool when one is given.
+  class FOVBatch {
+    public:
+    struct Viewer {
+      Vec2i pos;
+      unsigned int radius;
+    };
+
+    FOVBatch() = default;
+    FOVBatch(const FOVBatch & other) = delete;
+    FOVBatch & operator=(const FOVBatch & other) = delete;
+
+    void compute(const Map<unsigned int> & solid_map,
+                 const std::vector<Viewer> & viewers,
+                 ThreadPool * pool = nullptr);
+
+    // number of viewers in the last batch
+    unsigned int size() const { return viewer_num; }
+
+    const BresenhamFOV & fov(unsigned int viewer) const { return fovs[viewer]; }
+    bool can_see(unsigned int viewer, Vec2i pos) const { return fovs[viewer].is_visible(pos); }
+    // Writes the index of every viewer which sees `pos` into `viewers_out`.
+    void find_viewers(std::vector<unsigned int> & viewers_out, Vec2i pos) const;
+
+    static void test();
+
+    private:
+    std::vector<BresenhamFOV> fovs;
+    unsigned int viewer_num = 0;
+
+    // indexed by radius, built when first needed
+    std::vector<std::unique_ptr<RayTable>> tables;
+
+    const RayTable & table(unsigned int radius);
+  };
+}
+
+#endif
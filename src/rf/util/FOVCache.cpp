@@ -0,0 +1,213 @@
+
+#include "FOVCache.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <algorithm>
+#include <random>
+
+namespace rf {
+  FOVCache::FOVCache(unsigned int capacity)
+    : capacity(capacity) {
+    assert(capacity > 0);
+  }
+
+  uint64_t FOVCache::cell_hash(Vec2i pos) {
+    // splitmix64 of the packed coordinates
+    uint64_t z = ((uint64_t)(uint32_t)pos.x << 32 | (uint32_t)pos.y) + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  // xor of the hashes of every solid cell of `rect` which is on the map
+  uint64_t FOVCache::hash_rect(const Map<unsigned int> & solid_map, const Rect2i & rect) const {
+    int x0 = std::max(rect.pos.x, 0);
+    int y0 = std::max(rect.pos.y, 0);
+    int x1 = std::min(rect.pos.x + rect.size.x, (int)map_size.x);
+    int y1 = std::min(rect.pos.y + rect.size.y, (int)map_size.y);
+
+    uint64_t hash = 0;
+    for(int y = y0 ; y < y1 ; y ++) {
+      for(int x = x0 ; x < x1 ; x ++) {
+        if(solid_map[Vec2u(x, y)] == 1) {
+          hash ^= cell_hash(Vec2i(x, y));
+        }
+      }
+    }
+    return hash;
+  }
+
+  void FOVCache::move_window(const Map<unsigned int> & solid_map, Vec2i p, unsigned int r) {
+    int w = 2*r + 1;
+    Vec2i d = p - window_center;
+
+    // sliding the window costs two strips per step; past half its width,
+    // hashing it afresh is cheaper
+    if(!tracking ||
+       window_radius != r ||
+       map_size != solid_map.size() ||
+       2*(std::abs(d.x) + std::abs(d.y)) >= w) {
+      tracking = true;
+      map_size = solid_map.size();
+      window_center = p;
+      window_radius = r;
+      window_hash = hash_rect(solid_map, Rect2i(p - Vec2i(r, r), Vec2i(w, w)));
+      return;
+    }
+
+    int ir = r;
+    Vec2i c = window_center;
+
+    // columns leaving and entering as the window moves along x
+    if(d.x > 0) {
+      window_hash ^= hash_rect(solid_map, Rect2i(c.x - ir, c.y - ir, d.x, w));
+      window_hash ^= hash_rect(solid_map, Rect2i(c.x + ir + 1, c.y - ir, d.x, w));
+    } else if(d.x < 0) {
+      window_hash ^= hash_rect(solid_map, Rect2i(c.x - ir + d.x, c.y - ir, -d.x, w));
+      window_hash ^= hash_rect(solid_map, Rect2i(c.x + ir + 1 + d.x, c.y - ir, -d.x, w));
+    }
+    c.x = p.x;
+
+    // then rows, as it moves along y
+    if(d.y > 0) {
+      window_hash ^= hash_rect(solid_map, Rect2i(c.x - ir, c.y - ir, w, d.y));
+      window_hash ^= hash_rect(solid_map, Rect2i(c.x - ir, c.y + ir + 1, w, d.y));
+    } else if(d.y < 0) {
+      window_hash ^= hash_rect(solid_map, Rect2i(c.x - ir, c.y - ir + d.y, w, -d.y));
+      window_hash ^= hash_rect(solid_map, Rect2i(c.x - ir, c.y + ir + 1 + d.y, w, -d.y));
+    }
+
+    window_center = p;
+  }
+
+  const BresenhamFOV & FOVCache::update(const Map<unsigned int> & solid_map, Vec2i p, unsigned int r) {
+    move_window(solid_map, p, r);
+
+    Key key;
+    key.origin = p;
+    key.radius = r;
+    key.hash = window_hash;
+
+    tick ++;
+
+    for(auto & entry : entries) {
+      if(entry.live && entry.key == key) {
+        entry.last_used = tick;
+        _hit_count ++;
+        return entry.fov;
+      }
+    }
+
+    _miss_count ++;
+
+    Entry * slot = nullptr;
+    if(entries.size() < capacity) {
+      entries.emplace_back();
+      slot = &entries.back();
+    } else {
+      slot = &entries[0];
+      for(auto & entry : entries) {
+        if(!entry.live) { slot = &entry; break; }
+        if(entry.last_used < slot->last_used) { slot = &entry; }
+      }
+    }
+
+    if(table.radius() != r) {
+      table = RayTable(r);
+    }
+
+    slot->key = key;
+    slot->fov.update(table, solid_map, p);
+    slot->last_used = tick;
+    slot->live = true;
+    return slot->fov;
+  }
+
+  void FOVCache::notify_changed(Vec2i pos) {
+    if(!tracking) { return; }
+    if(pos.x < 0 || pos.y < 0 || pos.x >= (int)map_size.x || pos.y >= (int)map_size.y) { return; }
+
+    Vec2i d = pos - window_center;
+    if(std::abs(d.x) <= (int)window_radius && std::abs(d.y) <= (int)window_radius) {
+      window_hash ^= cell_hash(pos);
+    }
+  }
+
+  void FOVCache::clear() {
+    for(auto & entry : entries) {
+      entry.live = false;
+    }
+    tracking = false;
+  }
+
+  void FOVCache::reset_counters() {
+    _hit_count = 0;
+    _miss_count = 0;
+  }
+
+  void FOVCache::test() {
+    std::mt19937 gen(17);
+
+    BresenhamFOV expected;
+    BitGrid cached_bits;
+    BitGrid expected_bits;
+    unsigned long hit_count = 0;
+
+    for(int i = 0 ; i < 20 ; i ++) {
+      Vec2u size(1 + gen() % 50, 1 + gen() % 50);
+
+      Map<unsigned int> solid_map(size);
+      for(unsigned int y = 0 ; y < size.y ; y ++) {
+        for(unsigned int x = 0 ; x < size.x ; x ++) {
+          solid_map[Vec2u(x, y)] = gen() % 5 == 0;
+        }
+      }
+
+      FOVCache cache(1 + gen() % 8);
+
+      // a viewer wandering back and forth, sometimes jumping, while walls
+      // come and go around it
+      Vec2i p(gen() % size.x, gen() % size.y);
+      unsigned int r = gen() % 12;
+
+      for(int step = 0 ; step < 200 ; step ++) {
+        switch(gen() % 8) {
+          case 0:
+            p = Vec2i(gen() % (size.x + 10), gen() % (size.y + 10)) - Vec2i(5, 5);
+            break;
+          case 1:
+            r = gen() % 12;
+            break;
+          case 2: {
+            Vec2u q(gen() % size.x, gen() % size.y);
+            solid_map[q] = !solid_map[q];
+            cache.notify_changed(Vec2i(q));
+            break;
+          }
+          default:
+            p += Vec2i((int)(gen() % 3) - 1, (int)(gen() % 3) - 1);
+            break;
+        }
+
+        auto & fov = cache.update(solid_map, p, r);
+        expected.update_stepwise(solid_map, p, r);
+
+        assert(cache.window_hash == cache.hash_rect(solid_map, Rect2i(p - Vec2i(r, r), Vec2i(2*r + 1, 2*r + 1))));
+
+        Rect2i rect(p - Vec2i(r + 1, r + 1), Vec2i(2*r + 3, 2*r + 3));
+        fov.sample_into(cached_bits, rect);
+        expected.sample_into(expected_bits, rect);
+        for(int y = 0 ; y < rect.size.y ; y ++) {
+          for(int x = 0 ; x < rect.size.x ; x ++) {
+            assert(cached_bits.get(Vec2u(x, y)) == expected_bits.get(Vec2u(x, y)));
+          }
+        }
+      }
+
+      hit_count += cache.hit_count();
+    }
+
+    assert(hit_count > 0);
+  }
+}
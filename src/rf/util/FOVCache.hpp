@@ -0,0 +1,78 @@
+#ifndef RF_UTIL_FOVCACHE_HPP
+#define RF_UTIL_FOVCACHE_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <rf/util/Vec2.hpp>
+#include <rf/util/Map.hpp>
+#include <rf/util/FOV.hpp>
+
+namespace rf {
+  // Remembers the last few BresenhamFOVs computed over one solid map, keyed
+  // on their origin, radius, and a hash of the solid cells within the radius.
+  // The hash of the window around the last origin is kept up to date: moving
+  // the origin a step rehashes only the row or column crossed, and cells
+  // reported by notify_changed() toggle in and out of it directly.
+  class FOVCache {
+    public:
+    FOVCache(unsigned int capacity = 16);
+    FOVCache(const FOVCache & other) = delete;
+    FOVCache & operator=(const FOVCache & other) = delete;
+
+    // As BresenhamFOV::update, but returning a cached FOV when the cells
+    // around `p` are as they were when it was computed.
+    const BresenhamFOV & update(const Map<unsigned int> & solid_map, Vec2i p, unsigned int r);
+
+    // Must be called whenever a cell of the solid map switches between
+    // solid and not.
+    void notify_changed(Vec2i pos);
+    // Drops every FOV, for when the solid map is replaced outright.
+    void clear();
+
+    unsigned long hit_count() const { return _hit_count; }
+    unsigned long miss_count() const { return _miss_count; }
+    void reset_counters();
+
+    static void test();
+
+    private:
+    struct Key {
+      Vec2i origin;
+      unsigned int radius;
+      uint64_t hash;
+
+      bool operator==(const Key & other) const {
+        return origin == other.origin && radius == other.radius && hash == other.hash;
+      }
+    };
+    struct Entry {
+      Key key;
+      BresenhamFOV fov;
+      uint64_t last_used = 0;
+      bool live = false;
+    };
+
+    unsigned int capacity;
+    uint64_t tick = 0;
+    std::vector<Entry> entries;
+
+    RayTable table;
+
+    // the window whose hash is tracked
+    bool tracking = false;
+    Vec2u map_size;
+    Vec2i window_center;
+    unsigned int window_radius = 0;
+    uint64_t window_hash = 0;
+
+    unsigned long _hit_count = 0;
+    unsigned long _miss_count = 0;
+
+    static uint64_t cell_hash(Vec2i pos);
+    uint64_t hash_rect(const Map<unsigned int> & solid_map, const Rect2i & rect) const;
+    void move_window(const Map<unsigned int> & solid_map, Vec2i p, unsigned int r);
+  };
+}
+
+#endif
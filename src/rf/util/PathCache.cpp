@@ -0,0 +1,299 @@
+
+#include "PathCache.hpp"
+#include "Dijkstra.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <algorithm>
+#include <random>
+
+namespace rf {
+  size_t PathCache::KeyHash::operator()(const Key & key) const {
+    uint64_t h = 0;
+    for(uint64_t v : { (uint64_t)(uint32_t)key.start.x, (uint64_t)(uint32_t)key.start.y,
+                       (uint64_t)(uint32_t)key.end.x, (uint64_t)(uint32_t)key.end.y,
+                       (uint64_t)key.moves, (uint64_t)key.version }) {
+      h = (h ^ v) * 0x9E3779B97F4A7C15ull;
+    }
+    return h ^ (h >> 32);
+  }
+
+  PathCache::PathCache(unsigned int capacity, unsigned int region_size)
+    : capacity(capacity)
+    , region_size(region_size) {
+    assert(capacity > 0);
+    assert(region_size > 0);
+  }
+
+  uint64_t PathCache::region_key(Vec2i pos) const {
+    uint64_t x = (uint32_t)pos.x / region_size;
+    uint64_t y = (uint32_t)pos.y / region_size;
+    return (y << 32) | x;
+  }
+
+  unsigned int PathCache::allocate() {
+    if(free_entries.empty()) {
+      if(entries.size() < capacity) {
+        entries.emplace_back();
+        return entries.size() - 1;
+      }
+
+      // evict the least recently used path
+      unsigned int oldest = 0;
+      for(unsigned int i = 1 ; i < entries.size() ; i ++) {
+        if(entries[i].last_used < entries[oldest].last_used) {
+          oldest = i;
+        }
+      }
+      release(oldest);
+    }
+
+    unsigned int entry = free_entries.back();
+    free_entries.pop_back();
+    return entry;
+  }
+  void PathCache::release(unsigned int entry) {
+    Entry & e = entries[entry];
+    assert(e.live);
+
+    auto it = index.find(e.key);
+    if(it != index.end() && it->second == entry) {
+      index.erase(it);
+    }
+
+    e.live = false;
+    e.serial ++;
+    e.path.clear();
+    free_entries.push_back(entry);
+  }
+
+  void PathCache::insert(const Key & key, const std::vector<Vec2i> & path) {
+    unsigned int entry = allocate();
+
+    Entry & e = entries[entry];
+    e.key = key;
+    e.path = path;
+    e.last_used = tick;
+    e.live = true;
+    index[key] = entry;
+
+    std::vector<uint64_t> path_regions;
+    for(auto & pos : path) {
+      path_regions.push_back(region_key(pos));
+    }
+    std::sort(path_regions.begin(), path_regions.end());
+    path_regions.erase(std::unique(path_regions.begin(), path_regions.end()), path_regions.end());
+
+    for(auto region : path_regions) {
+      regions[region].push_back(std::make_pair(entry, e.serial));
+    }
+  }
+
+  bool PathCache::find(std::vector<Vec2i> & path_out,
+                       const Map<unsigned int> & cost_map,
+                       Vec2i start_pos,
+                       Vec2i end_pos,
+                       Moves moves) {
+    tick ++;
+
+    Key key = { start_pos, end_pos, moves, _version };
+
+    auto it = index.find(key);
+    if(it != index.end()) {
+      Entry & e = entries[it->second];
+      e.last_used = tick;
+      path_out = e.path;
+      _hit_count ++;
+      return true;
+    }
+
+    _miss_count ++;
+
+    bool found;
+    if(moves == FOUR) {
+      found = search.find4(path_out, cost_map, start_pos, end_pos);
+    } else {
+      found = search.find8(path_out, cost_map, start_pos, end_pos);
+    }
+
+    if(found) {
+      insert(key, path_out);
+    }
+
+    return found;
+  }
+
+  void PathCache::invalidate(const std::vector<Vec2u> & changed) {
+    for(auto & changed_pos : changed) {
+      Vec2i pos(changed_pos);
+
+      auto region_it = regions.find(region_key(pos));
+      if(region_it == regions.end()) { continue; }
+
+      auto & region_entries = region_it->second;
+      unsigned int kept = 0;
+
+      for(unsigned int i = 0 ; i < region_entries.size() ; i ++) {
+        unsigned int entry = region_entries[i].first;
+        Entry & e = entries[entry];
+
+        // forget entries whose slot has been released or reused since
+        if(!e.live || e.serial != region_entries[i].second) { continue; }
+        region_entries[kept ++] = region_entries[i];
+
+        // the start is never entered, so its cost doesn't matter
+        unsigned int k = 0;
+        while(k + 1 < e.path.size() && e.path[k] != pos) { k ++; }
+        if(k + 1 >= e.path.size()) { continue; }
+
+        _invalidated_count ++;
+
+        if(k == 0) {
+          // the end itself changed
+          release(entry);
+          continue;
+        }
+
+        // keep the part after the changed cell, as a path starting there
+        Key key = { pos, e.key.end, e.key.moves, _version };
+        index.erase(e.key);
+        e.path.resize(k + 1);
+        e.key = key;
+
+        if(index.count(key)) {
+          // already cached from there
+          release(entry);
+        } else {
+          index[key] = entry;
+        }
+      }
+
+      region_entries.resize(kept);
+      if(region_entries.empty()) {
+        regions.erase(region_it);
+      }
+    }
+  }
+
+  void PathCache::clear() {
+    for(unsigned int i = 0 ; i < entries.size() ; i ++) {
+      if(entries[i].live) {
+        release(i);
+      }
+    }
+    regions.clear();
+    _version ++;
+  }
+
+  void PathCache::reset_counters() {
+    _hit_count = 0;
+    _miss_count = 0;
+    _invalidated_count = 0;
+  }
+
+#ifndef NDEBUG
+  static unsigned int path_cost(const std::vector<Vec2i> & path,
+                                const Map<unsigned int> & cost_map) {
+    unsigned int cost = 0;
+    for(unsigned int i = 0 ; i + 1 < path.size() ; i ++) {
+      assert(std::max(std::abs(path[i].x - path[i + 1].x),
+                      std::abs(path[i].y - path[i + 1].y)) == 1);
+      assert(cost_map[path[i]] != DijkstraMap::impassable);
+      cost += cost_map[path[i]];
+    }
+    return cost;
+  }
+#endif
+
+  void PathCache::test() {
+    std::mt19937 gen(10);
+
+    AStarSearch search;
+    std::vector<Vec2i> path;
+    std::vector<Vec2i> expected;
+    unsigned long hit_count = 0;
+
+    for(int i = 0 ; i < 20 ; i ++) {
+      Vec2u size(4 + gen() % 40, 4 + gen() % 40);
+
+      Map<unsigned int> costs(size);
+      for(unsigned int y = 0 ; y < size.y ; y ++) {
+        for(unsigned int x = 0 ; x < size.x ; x ++) {
+          costs[Vec2u(x, y)] = (gen() % 5 == 0) ? DijkstraMap::impassable : 1 + gen() % 3;
+        }
+      }
+
+      // caches which are sometimes too small, so that eviction happens too
+      PathCache cache(4 + gen() % 16, 1 + gen() % 8);
+
+      // walkers follow their paths one step at a time, blocking each cell
+      // they step into, while walls appear around them; walls only make
+      // paths more expensive, so cached paths must remain shortest
+      std::vector<std::pair<Vec2i, Vec2i>> walkers;
+      for(int j = 0 ; j < 12 ; j ++) {
+        walkers.push_back(std::make_pair(Vec2i(gen() % size.x, gen() % size.y),
+                                         Vec2i(gen() % size.x, gen() % size.y)));
+      }
+
+      for(int round = 0 ; round < 30 ; round ++) {
+        for(auto & walker : walkers) {
+          Moves moves = (&walker - &walkers[0]) % 2 ? FOUR : EIGHT;
+
+          bool found = cache.find(path, costs, walker.first, walker.second, moves);
+          bool expected_found = (moves == FOUR) ?
+            search.find4(expected, costs, walker.first, walker.second) :
+            search.find8(expected, costs, walker.first, walker.second);
+          (void)expected_found;
+
+          assert(found == expected_found);
+          if(found) {
+            assert(path.front() == walker.second);
+            assert(path.back() == walker.first);
+            assert(path_cost(path, costs) == path_cost(expected, costs));
+
+            if(path.size() >= 2) {
+              walker.first = path[path.size() - 2];
+              costs[walker.first] = DijkstraMap::impassable;
+              cache.invalidate({ Vec2u(walker.first) });
+            }
+          }
+        }
+
+        std::vector<Vec2u> changed;
+        for(int j = 0 ; j < 2 ; j ++) {
+          Vec2u p(gen() % size.x, gen() % size.y);
+          costs[p] = DijkstraMap::impassable;
+          changed.push_back(p);
+        }
+        cache.invalidate(changed);
+      }
+
+      hit_count += cache.hit_count();
+    }
+    assert(hit_count > 0);
+
+    // a walker marking its own cell impassable finds its cut path again
+    Map<unsigned int> costs(Vec2u(10, 10));
+    costs.fill(1);
+
+    PathCache cache;
+    Vec2i end(9, 9);
+    assert(cache.find(path, costs, Vec2i(0, 0), end, EIGHT));
+    assert(cache.miss_count() == 1);
+
+    Vec2i next = path[path.size() - 2];
+    costs[next] = DijkstraMap::impassable;
+    cache.invalidate({ Vec2u(0, 0), Vec2u(next) });
+    assert(cache.invalidated_count() == 1);
+
+    assert(cache.find(path, costs, next, end, EIGHT));
+    assert(cache.hit_count() == 1);
+    assert(cache.miss_count() == 1);
+
+    // and nothing survives a clear()
+    cache.clear();
+    assert(cache.size() == 0);
+    assert(cache.find(path, costs, next, end, EIGHT));
+    assert(cache.miss_count() == 2);
+  }
+}
@@ -0,0 +1,104 @@
+#ifndef RF_UTIL_PATHCACHE_HPP
+#define RF_UTIL_PATHCACHE_HPP
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <rf/util/Vec2.hpp>
+#include <rf/util/Map.hpp>
+#include <rf/util/AStar.hpp>
+
+namespace rf {
+  // Remembers the paths found by A* over one cost map, keyed on their start,
+  // end, moves, and the version of the cost map. Whoever changes the costs
+  // reports the changed cells with invalidate(): a path entering one of them
+  // is cut down to the part after it, which starts at the changed cell and
+  // so is found again once a walker steps there. A walker that blocks the
+  // cell it steps into thus gets the rest of its path back. Cells made
+  // cheaper off a path leave it cached, so it stays valid but may not be the
+  // shortest.
+  class PathCache {
+    public:
+    enum Moves { FOUR, EIGHT };
+
+    PathCache(unsigned int capacity = 256, unsigned int region_size = 16);
+    PathCache(const PathCache & other) = delete;
+    PathCache & operator=(const PathCache & other) = delete;
+
+    // As DoAStar4 / DoAStar8, but reusing a cached path when there is one
+    // for the same endpoints.
+    bool find(std::vector<Vec2i> & path_out,
+              const Map<unsigned int> & cost_map,
+              Vec2i start_pos,
+              Vec2i end_pos,
+              Moves moves);
+
+    // Cuts every path at the first changed cell it enters.
+    void invalidate(const std::vector<Vec2u> & changed);
+    // Drops every path, by moving on to a new version of the cost map.
+    void clear();
+
+    unsigned int version() const { return _version; }
+    unsigned int size() const { return index.size(); }
+
+    // cached paths returned, and A* searches
+    unsigned long hit_count() const { return _hit_count; }
+    unsigned long miss_count() const { return _miss_count; }
+    // number of paths cut or dropped by invalidate()
+    unsigned long invalidated_count() const { return _invalidated_count; }
+    void reset_counters();
+
+    static void test();
+
+    private:
+    struct Key {
+      Vec2i start;
+      Vec2i end;
+      Moves moves;
+      unsigned int version;
+
+      bool operator==(const Key & other) const {
+        return start == other.start && end == other.end &&
+               moves == other.moves && version == other.version;
+      }
+    };
+    struct KeyHash {
+      size_t operator()(const Key & key) const;
+    };
+
+    struct Entry {
+      Key key;
+      // from end back to start, as returned by DoAStar8
+      std::vector<Vec2i> path;
+      uint64_t last_used = 0;
+      // bumped whenever the slot is reused, so stale region lists can tell
+      uint32_t serial = 0;
+      bool live = false;
+    };
+
+    unsigned int capacity;
+    unsigned int region_size;
+    unsigned int _version = 0;
+    uint64_t tick = 0;
+
+    std::vector<Entry> entries;
+    std::vector<unsigned int> free_entries;
+    std::unordered_map<Key, unsigned int, KeyHash> index;
+    // entries (and their serials) whose path passes through each region
+    std::unordered_map<uint64_t, std::vector<std::pair<unsigned int, uint32_t>>> regions;
+
+    AStarSearch search;
+
+    unsigned long _hit_count = 0;
+    unsigned long _miss_count = 0;
+    unsigned long _invalidated_count = 0;
+
+    uint64_t region_key(Vec2i pos) const;
+    unsigned int allocate();
+    void release(unsigned int entry);
+    void insert(const Key & key, const std::vector<Vec2i> & path);
+  };
+}
+
+#endif
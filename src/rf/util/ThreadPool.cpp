@@ -0,0 +1,82 @@
+
+#include "ThreadPool.hpp"
+
+namespace rf {
+  ThreadPool::ThreadPool(unsigned int thread_num)
+    : next_task(0) {
+    if(thread_num == 0) {
+      thread_num = std::thread::hardware_concurrency();
+    }
+    for(unsigned int i = 1 ; i < thread_num ; i ++) {
+      threads.emplace_back(&ThreadPool::thread_main, this, i);
+    }
+  }
+  ThreadPool::~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    start_cv.notify_all();
+    for(auto & t : threads) {
+      t.join();
+    }
+  }
+
+  void ThreadPool::run(unsigned int task_num, const Task & task) {
+    if(task_num == 0) {
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      batch_task = &task;
+      batch_size = task_num;
+      batch_id ++;
+      busy_threads = threads.size();
+      next_task = 0;
+    }
+    start_cv.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this]() { return busy_threads == 0; });
+    batch_task = nullptr;
+  }
+
+  void ThreadPool::thread_main(unsigned int worker) {
+    unsigned int last_batch_id = 0;
+
+    while(true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        start_cv.wait(lock, [this, last_batch_id]() {
+          return stopping || batch_id != last_batch_id;
+        });
+        if(stopping) {
+          return;
+        }
+        last_batch_id = batch_id;
+      }
+
+      work(worker);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        busy_threads --;
+        if(busy_threads == 0) {
+          done_cv.notify_one();
+        }
+      }
+    }
+  }
+  void ThreadPool::work(unsigned int worker) {
+    while(true) {
+      unsigned int task = next_task ++;
+      if(task >= batch_size) {
+        break;
+      }
+      (*batch_task)(task, worker);
+    }
+  }
+}
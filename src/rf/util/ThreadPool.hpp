@@ -0,0 +1,52 @@
+#ifndef RF_UTIL_THREADPOOL_HPP
+#define RF_UTIL_THREADPOOL_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+
+namespace rf {
+  // A fixed set of worker threads which split up batches of independent
+  // tasks. The thread calling run(...) works on the batch as well.
+  class ThreadPool {
+    public:
+    typedef std::function<void(unsigned int task, unsigned int worker)> Task;
+
+    // `thread_num` counts the calling thread; 0 uses one thread per core
+    ThreadPool(unsigned int thread_num = 0);
+    ThreadPool(const ThreadPool & other) = delete;
+    ThreadPool & operator=(const ThreadPool & other) = delete;
+    ~ThreadPool();
+
+    // number of workers, including the calling thread
+    unsigned int size() const { return threads.size() + 1; }
+
+    // calls task(i, worker) for each i in [0, task_num), and returns once all
+    // calls have finished. `worker` is in [0, size()), and is never shared by
+    // two calls running at the same time.
+    void run(unsigned int task_num, const Task & task);
+
+    private:
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+
+    const Task * batch_task = nullptr;
+    unsigned int batch_size = 0;
+    unsigned int batch_id = 0;
+    unsigned int busy_threads = 0;
+    bool stopping = false;
+
+    std::atomic<unsigned int> next_task;
+
+    void thread_main(unsigned int worker);
+    void work(unsigned int worker);
+  };
+}
+
+#endif
@@ -0,0 +1,33 @@
+
+#include <cstdio>
+
+#include <rf/util/Dijkstra.hpp>
+#include <rf/util/Chamfer.hpp>
+#include <rf/util/AStar.hpp>
+#include <rf/util/ClusterGraph.hpp>
+#include <rf/util/PathCache.hpp>
+#include <rf/util/FOV.hpp>
+#include <rf/util/FOVBatch.hpp>
+#include <rf/util/FOVCache.hpp>
+#include <rf/util/Arena.hpp>
+
+using namespace rf;
+
+// the slower randomized self-tests, kept out of the game's startup path
+int main(int argc, char ** argv) {
+  DijkstraMap::test();
+  DijkstraMap::test_buckets();
+  DijkstraMap::test_batch();
+  DijkstraMap::test_bounded();
+  DijkstraMap::test_update();
+  ChamferMap::test();
+  AStarSearch::test();
+  ClusterGraph::test();
+  PathCache::test();
+  FOVBatch::test();
+  BresenhamFOV::test();
+  FOVCache::test();
+  Arena::test();
+  printf("all tests passed\n");
+  return 0;
+}